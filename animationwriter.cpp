@@ -0,0 +1,297 @@
+#include "animationwriter.h"
+#include "pngencoder.h"
+#include "colorquantizer.h"
+#include <QVector>
+#include <QDebug>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <cstring>
+
+static const int MaxLzwCodes = 4096;
+static const int LzwTableSize = 8192; // 开放寻址哈希表，装载率不超过一半
+
+static void appendUInt32(QByteArray &data, quint32 value)
+{
+    data.append(char((value >> 24) & 0xFF));
+    data.append(char((value >> 16) & 0xFF));
+    data.append(char((value >> 8) & 0xFF));
+    data.append(char(value & 0xFF));
+}
+
+static void appendUInt16(QByteArray &data, quint16 value)
+{
+    data.append(char(value >> 8));
+    data.append(char(value & 0xFF));
+}
+
+// GIF 中的多字节整数是小端序
+static void appendLittle16(QByteArray &data, int value)
+{
+    data.append(char(value & 0xFF));
+    data.append(char((value >> 8) & 0xFF));
+}
+
+// GIF 的 LZW 码流按最低位在前打包
+class LzwBitWriter {
+public:
+    QByteArray bytes;
+
+    void write(int code, int bits)
+    {
+        buffer |= quint32(code) << count;
+        count += bits;
+        while (count >= 8) {
+            bytes.append(char(buffer & 0xFF));
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+    void flush()
+    {
+        if (count > 0) {
+            bytes.append(char(buffer & 0xFF));
+        }
+        buffer = 0;
+        count = 0;
+    }
+
+private:
+    quint32 buffer = 0;
+    int count = 0;
+};
+
+// 变长码 LZW 压缩 Indexed8 像素。码表满 4096 项时输出清除码重新开始
+static QByteArray lzwEncode(const QImage &indexed, int minCodeSize)
+{
+    const int clearCode = 1 << minCodeSize;
+    const int endCode = clearCode + 1;
+    QVector<qint32> keys(LzwTableSize, -1);
+    QVector<qint16> codes(LzwTableSize, 0);
+    LzwBitWriter out;
+
+    int codeSize = minCodeSize + 1;
+    int maxCode = endCode;
+    out.write(clearCode, codeSize);
+    int current = -1;
+    for (int y = 0; y < indexed.height(); ++y) {
+        const uchar *row = indexed.constScanLine(y);
+        for (int x = 0; x < indexed.width(); ++x) {
+            int pixel = row[x];
+            if (current < 0) {
+                current = pixel;
+                continue;
+            }
+            qint32 key = (current << 8) | pixel;
+            int slot = int((quint32(key) * 2654435761u) >> 19) & (LzwTableSize - 1);
+            while (keys[slot] >= 0 && keys[slot] != key) {
+                slot = (slot + 1) & (LzwTableSize - 1);
+            }
+            if (keys[slot] == key) {
+                current = codes[slot];
+                continue;
+            }
+            out.write(current, codeSize);
+            ++maxCode;
+            keys[slot] = key;
+            codes[slot] = qint16(maxCode);
+            if (maxCode >= (1 << codeSize)) {
+                ++codeSize;
+            }
+            if (maxCode == MaxLzwCodes - 1) {
+                out.write(clearCode, codeSize);
+                keys.fill(-1);
+                codeSize = minCodeSize + 1;
+                maxCode = endCode;
+            }
+            current = pixel;
+        }
+    }
+    if (current >= 0) {
+        out.write(current, codeSize);
+    }
+    out.write(clearCode, codeSize);
+    out.write(endCode, minCodeSize + 1);
+    out.flush();
+    return out.bytes;
+}
+
+AnimationWriter::AnimationWriter(QIODevice *device, Format format)
+    : device(device), format(format)
+{
+}
+
+bool AnimationWriter::isSupported(Format format)
+{
+    return format == Gif || PngEncoder::isBuiltin();
+}
+
+// 只有 APNG 写 PNG 块，没有 zlib 时 begin() 已经拒绝了 APNG
+bool AnimationWriter::writeChunk(const char *type, const QByteArray &data)
+{
+#ifndef HAVE_ZLIB
+    Q_UNUSED(type);
+    Q_UNUSED(data);
+    return false;
+#else
+    QByteArray chunk;
+    appendUInt32(chunk, quint32(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef *>(chunk.constData() + 4), uInt(chunk.size() - 4));
+    appendUInt32(chunk, quint32(crc));
+    return device->write(chunk) == chunk.size();
+#endif
+}
+
+bool AnimationWriter::begin(const QSize &frameSize)
+{
+    size = frameSize;
+    if (!isSupported(format)) {
+        qDebug() << "AnimationWriter: APNG needs the built-in PNG encoder (zlib)";
+        ok = false;
+        return ok;
+    }
+    if (format == Apng) {
+        ok = device->write("\x89PNG\r\n\x1a\n", 8) == 8;
+        QByteArray header;
+        appendUInt32(header, quint32(size.width()));
+        appendUInt32(header, quint32(size.height()));
+        header.append(char(8)); // 位深
+        header.append(char(2)); // 真彩色，各帧都转换成不透明 RGB
+        header.append(char(0));
+        header.append(char(0));
+        header.append(char(0));
+        ok = ok && writeChunk("IHDR", header);
+        // 帧数先写 0，finish() 时回填；播放次数 0 表示无限循环
+        actlOffset = device->pos();
+        QByteArray control;
+        appendUInt32(control, 0);
+        appendUInt32(control, 0);
+        ok = ok && writeChunk("acTL", control);
+    } else {
+        QByteArray header("GIF89a");
+        appendLittle16(header, size.width());
+        appendLittle16(header, size.height());
+        header.append(char(0)); // 不使用全局调色板，每帧各带局部调色板
+        header.append(char(0));
+        header.append(char(0));
+        // NETSCAPE2.0 扩展：无限循环
+        header.append("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01", 16);
+        appendLittle16(header, 0);
+        header.append(char(0));
+        ok = device->write(header) == header.size();
+    }
+    return ok;
+}
+
+bool AnimationWriter::addFrame(const QRect &rect, const QImage &patch, int delayMs)
+{
+    if (!ok || patch.isNull() || rect.size() != patch.size() || !QRect(QPoint(0, 0), size).contains(rect)) {
+        return false;
+    }
+    // APNG 的第一帧就是默认图像，必须覆盖整幅画面
+    if (frames == 0 && rect != QRect(QPoint(0, 0), size)) {
+        return false;
+    }
+    ok = format == Apng ? addApngFrame(rect, patch, delayMs) : addGifFrame(rect, patch, delayMs);
+    ++frames;
+    return ok;
+}
+
+bool AnimationWriter::addApngFrame(const QRect &rect, const QImage &patch, int delayMs)
+{
+    // 录屏以速度优先，用最快档的并行编码器压缩每一帧
+    QByteArray data = PngEncoder(PngEncoder::Fastest).imageData(patch.convertToFormat(QImage::Format_RGB32));
+    if (data.isEmpty()) {
+        return false;
+    }
+    QByteArray control;
+    appendUInt32(control, sequence++);
+    appendUInt32(control, quint32(rect.width()));
+    appendUInt32(control, quint32(rect.height()));
+    appendUInt32(control, quint32(rect.x()));
+    appendUInt32(control, quint32(rect.y()));
+    appendUInt16(control, quint16(qBound(0, delayMs, 65535))); // 时长 = delayMs / 1000 秒
+    appendUInt16(control, 1000);
+    control.append(char(0)); // APNG_DISPOSE_OP_NONE：保留画面，下一帧叠加在上面
+    control.append(char(0)); // APNG_BLEND_OP_SOURCE：直接覆盖
+    if (!writeChunk("fcTL", control)) {
+        return false;
+    }
+    if (frames == 0) {
+        return writeChunk("IDAT", data);
+    }
+    QByteArray frameData;
+    appendUInt32(frameData, sequence++);
+    frameData.append(data);
+    return writeChunk("fdAT", frameData);
+}
+
+bool AnimationWriter::addGifFrame(const QRect &rect, const QImage &patch, int delayMs)
+{
+    // 每帧单独量化，颜色超过 256 种时也必须得到调色板图像
+    ColorQuantizer quantizer(256, false);
+    quantizer.setMaxError(1e9);
+    QImage indexed = quantizer.quantize(patch.convertToFormat(QImage::Format_RGB32));
+    if (indexed.isNull()) {
+        return false;
+    }
+    const QVector<QRgb> colors = indexed.colorTable();
+    int tableBits = 1;
+    while ((1 << tableBits) < colors.size()) {
+        ++tableBits;
+    }
+
+    elapsedMs += qMax(0, delayMs);
+    qint64 endCs = (elapsedMs + 5) / 10;
+    int delayCs = int(qMin<qint64>(endCs - elapsedCs, 65535));
+    elapsedCs += delayCs;
+
+    QByteArray block;
+    // 图形控制扩展：处置方式 1（保留），不使用透明色
+    block.append("\x21\xF9\x04\x04", 4);
+    appendLittle16(block, delayCs);
+    block.append(char(0));
+    block.append(char(0));
+    // 图像描述符，带局部调色板
+    block.append(char(0x2C));
+    appendLittle16(block, rect.x());
+    appendLittle16(block, rect.y());
+    appendLittle16(block, rect.width());
+    appendLittle16(block, rect.height());
+    block.append(char(0x80 | (tableBits - 1)));
+    for (int i = 0; i < (1 << tableBits); ++i) {
+        QRgb color = i < colors.size() ? colors[i] : 0;
+        block.append(char(qRed(color)));
+        block.append(char(qGreen(color)));
+        block.append(char(qBlue(color)));
+    }
+    int minCodeSize = qMax(2, tableBits);
+    block.append(char(minCodeSize));
+    QByteArray codes = lzwEncode(indexed, minCodeSize);
+    for (int offset = 0; offset < codes.size(); offset += 255) {
+        int length = qMin(255, int(codes.size()) - offset);
+        block.append(char(length));
+        block.append(codes.constData() + offset, length);
+    }
+    block.append(char(0));
+    return device->write(block) == block.size();
+}
+
+bool AnimationWriter::finish()
+{
+    if (format == Apng) {
+        ok = ok && writeChunk("IEND", QByteArray());
+        // 回填 acTL 中的帧数
+        qint64 end = device->pos();
+        QByteArray control;
+        appendUInt32(control, quint32(frames));
+        appendUInt32(control, 0);
+        ok = ok && device->seek(actlOffset) && writeChunk("acTL", control) && device->seek(end);
+    } else {
+        ok = ok && device->write("\x3B", 1) == 1;
+    }
+    qDebug() << "AnimationWriter: Finished" << (format == Apng ? "APNG" : "GIF") << "with" << frames << "frames, ok:" << ok;
+    return ok && frames > 0;
+}
@@ -0,0 +1,43 @@
+#ifndef ANIMATIONWRITER_H
+#define ANIMATIONWRITER_H
+
+#include <QImage>
+#include <QIODevice>
+#include <QRect>
+#include <QSize>
+
+// 逐帧写出 APNG 或 GIF 动画。第一帧是完整画面，之后每帧只写发生变化的子矩形，
+// 叠加在前一帧上（不清除、不混合）。帧的时长在写入时就要确定，由调用方负责延后一帧写入。
+// APNG 的帧数写在文件开头，finish() 时回填，所以设备必须可以 seek。
+// APNG 的各帧由内置 PNG 编码器压缩，没有 zlib 时只能写 GIF。
+class AnimationWriter {
+public:
+    enum Format { Apng, Gif };
+
+    AnimationWriter(QIODevice *device, Format format);
+
+    bool begin(const QSize &size);
+    bool addFrame(const QRect &rect, const QImage &patch, int delayMs); // rect 基于整幅画面
+    bool finish();
+
+    int frameCount() const { return frames; }
+
+    static bool isSupported(Format format);
+
+private:
+    QIODevice *device;
+    Format format;
+    QSize size;
+    int frames = 0;
+    quint32 sequence = 0;   // APNG 的 fcTL/fdAT 序号
+    qint64 actlOffset = 0;  // APNG acTL 块的位置，finish() 时回填帧数
+    qint64 elapsedMs = 0;   // GIF 按累计时间取整到 1/100 秒，避免误差累积
+    qint64 elapsedCs = 0;
+    bool ok = true;
+
+    bool addApngFrame(const QRect &rect, const QImage &patch, int delayMs);
+    bool addGifFrame(const QRect &rect, const QImage &patch, int delayMs);
+    bool writeChunk(const char *type, const QByteArray &data);
+};
+
+#endif // ANIMATIONWRITER_H
@@ -0,0 +1,298 @@
+#include "capturearchive.h"
+#include "pngencoder.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QLockFile>
+#include <QMutex>
+#include <QSaveFile>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+
+static const char Magic[8] = {'S', 'S', 'H', 'O', 'T', 'A', 'R', 'C'};
+static const int HeaderSize = 16;
+static const int RecordSize = 48; // dHash (8) + 像素 SHA-256 (32) + 时间 (8)
+static const int Chunks = 4;
+static const int MaxSampledRows = 512;
+
+struct ArchiveRecord {
+    quint64 hash;
+    QByteArray sha256;
+};
+
+// 进程内的索引副本，新增记录前先读入其它进程追加的部分
+struct ArchiveIndex {
+    QMutex mutex;
+    QString root;
+    qint64 loadedBytes = 0;
+    QList<ArchiveRecord> records;
+    QHash<QByteArray, int> bySha;
+    QHash<quint16, QList<int>> byChunk[Chunks];
+
+    void insert(const ArchiveRecord &record)
+    {
+        int id = records.size();
+        records.append(record);
+        bySha.insert(record.sha256, id);
+        if (record.hash == 0) {
+            return; // 没有可用的 dHash，只参与完全相同的查找
+        }
+        for (int c = 0; c < Chunks; ++c) {
+            byChunk[c][quint16(record.hash >> (16 * c))].append(id);
+        }
+    }
+
+    void clear()
+    {
+        loadedBytes = 0;
+        records.clear();
+        bySha.clear();
+        for (auto &table : byChunk) {
+            table.clear();
+        }
+    }
+};
+
+static ArchiveIndex &archiveIndex()
+{
+    static ArchiveIndex index;
+    return index;
+}
+
+void CaptureArchive::setRoot(const QString &dir)
+{
+    ArchiveIndex &index = archiveIndex();
+    QMutexLocker locker(&index.mutex);
+    index.clear();
+    index.root = dir;
+    if (!dir.isEmpty()) {
+        QDir().mkpath(dir + "/objects");
+    }
+}
+
+bool CaptureArchive::isEnabled()
+{
+    ArchiveIndex &index = archiveIndex();
+    QMutexLocker locker(&index.mutex);
+    return !index.root.isEmpty();
+}
+
+// 9x8 灰度缩略图中每行相邻两格比较得到 64 位。
+// 每行先转成亮度（简单的逐像素整数运算，编译器可以向量化），再按列区间累加；
+// 大图只等间隔取样最多 MaxSampledRows 行。
+// 纯色或空白图像的哈希全为 0，任意两幅都会被当成近似重复，所以这类图像返回 false；
+// 哈希 0 同时用作“没有 dHash”的标记，极少数恰好算出 0 的图像也一并按无效处理。
+bool CaptureArchive::dHash(const QImage &source, quint64 &hash)
+{
+    hash = 0;
+    QImage image = source.format() == QImage::Format_RGB32 || source.format() == QImage::Format_ARGB32
+                           || source.format() == QImage::Format_ARGB32_Premultiplied
+                       ? source : source.convertToFormat(QImage::Format_RGB32);
+    const int width = image.width();
+    const int height = image.height();
+    if (width < 9 || height < 8) {
+        return false;
+    }
+
+    quint64 sums[8][9] = {};
+    quint32 counts[8][9] = {};
+    int columnEnd[9];
+    for (int c = 0; c < 9; ++c) {
+        columnEnd[c] = (c + 1) * width / 9;
+    }
+    QVector<quint32> luma(width);
+    int step = qMax(1, height / MaxSampledRows);
+    for (int y = 0; y < height; y += step) {
+        const quint32 *row = reinterpret_cast<const quint32 *>(image.constScanLine(y));
+        quint32 *out = luma.data();
+        for (int x = 0; x < width; ++x) {
+            quint32 p = row[x];
+            out[x] = (((p >> 16) & 0xff) * 77 + ((p >> 8) & 0xff) * 150 + (p & 0xff) * 29) >> 8;
+        }
+        int band = y * 8 / height;
+        int x = 0;
+        for (int c = 0; c < 9; ++c) {
+            quint64 sum = 0;
+            for (; x < columnEnd[c]; ++x) {
+                sum += out[x];
+            }
+            sums[band][c] += sum;
+            counts[band][c] += quint32(columnEnd[c] - (c > 0 ? columnEnd[c - 1] : 0));
+        }
+    }
+
+    for (int r = 0; r < 8; ++r) {
+        for (int c = 0; c < 8; ++c) {
+            // 比较平均值：a/ca > b/cb 等价于 a*cb > b*ca
+            bool brighter = sums[r][c] * counts[r][c + 1] > sums[r][c + 1] * counts[r][c];
+            hash = (hash << 1) | (brighter ? 1 : 0);
+        }
+    }
+    return hash != 0;
+}
+
+static QByteArray pixelSha256(const QImage &image)
+{
+    QCryptographicHash sha(QCryptographicHash::Sha256);
+    int rowBytes = image.width() * image.depth() / 8;
+    QByteArray header = QByteArray::number(image.width()) + "x" + QByteArray::number(image.height())
+                        + ":" + QByteArray::number(int(image.format()));
+    sha.addData(header);
+    for (int y = 0; y < image.height(); ++y) {
+        sha.addData(QByteArrayView(reinterpret_cast<const char *>(image.constScanLine(y)), rowBytes));
+    }
+    return sha.result();
+}
+
+// 在持有文件锁时调用：读入 index.bin 中尚未加载的记录
+static void loadNewRecords(ArchiveIndex &index)
+{
+    QFile file(index.root + "/index.bin");
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= HeaderSize) {
+        return;
+    }
+    if (index.loadedBytes == 0) {
+        if (file.read(HeaderSize).left(sizeof(Magic)) != QByteArray(Magic, sizeof(Magic))) {
+            return;
+        }
+        index.loadedBytes = HeaderSize;
+    }
+    qint64 available = (file.size() - index.loadedBytes) / RecordSize * RecordSize;
+    if (available <= 0) {
+        return;
+    }
+    const uchar *map = file.map(index.loadedBytes, available);
+    QByteArray fallback;
+    if (!map) {
+        file.seek(index.loadedBytes);
+        fallback = file.read(available);
+        map = reinterpret_cast<const uchar *>(fallback.constData());
+    }
+    for (qint64 offset = 0; offset < available; offset += RecordSize) {
+        ArchiveRecord record;
+        record.hash = qFromLittleEndian<quint64>(map + offset);
+        record.sha256 = QByteArray(reinterpret_cast<const char *>(map + offset + 8), 32);
+        index.insert(record);
+    }
+    index.loadedBytes += available;
+}
+
+// 多索引哈希查询：返回汉明距离最小且不超过 maxDistance 的记录
+static int findNear(const ArchiveIndex &index, quint64 hash, int maxDistance, int &distance)
+{
+    const int chunkRadius = maxDistance / Chunks;
+    int best = -1;
+    distance = maxDistance + 1;
+    auto check = [&](quint16 key, int chunk) {
+        auto it = index.byChunk[chunk].constFind(key);
+        if (it == index.byChunk[chunk].constEnd()) {
+            return;
+        }
+        for (int id : it.value()) {
+            int d = qPopulationCount(index.records[id].hash ^ hash);
+            if (d < distance) {
+                distance = d;
+                best = id;
+            }
+        }
+    };
+    for (int c = 0; c < Chunks; ++c) {
+        quint16 key = quint16(hash >> (16 * c));
+        check(key, c);
+        if (chunkRadius >= 1) {
+            for (int i = 0; i < 16; ++i) {
+                check(quint16(key ^ (1u << i)), c);
+                for (int j = i + 1; chunkRadius >= 2 && j < 16; ++j) {
+                    check(quint16(key ^ (1u << i) ^ (1u << j)), c);
+                }
+            }
+        }
+    }
+    return best;
+}
+
+static void archive(const QImage &image, const QString &name, QByteArray png)
+{
+    QElapsedTimer timer;
+    timer.start();
+    quint64 hash = 0;
+    const bool hashValid = CaptureArchive::dHash(image, hash);
+    QByteArray sha = pixelSha256(image);
+    qint64 hashMs = timer.elapsed();
+
+    ArchiveIndex &index = archiveIndex();
+    QMutexLocker locker(&index.mutex);
+    if (index.root.isEmpty()) {
+        return;
+    }
+    QLockFile lock(index.root + "/archive.lock");
+    if (!lock.lock()) {
+        return;
+    }
+    loadNewRecords(index);
+
+    // 先查完全相同的像素，再查近似图像
+    QString kind;
+    QByteArray target;
+    auto exact = index.bySha.constFind(sha);
+    int distance = 0;
+    int near = -1;
+    if (exact != index.bySha.constEnd()) {
+        kind = "exact";
+        target = sha;
+    } else if (hashValid && (near = findNear(index, hash, CaptureArchive::NearDistance, distance)) >= 0) {
+        kind = QString("near:%1").arg(distance);
+        target = index.records[near].sha256;
+    }
+    qint64 lookupMs = timer.elapsed() - hashMs;
+
+    if (target.isEmpty()) {
+        if (png.isEmpty()) {
+            png = PngEncoder(PngEncoder::Balanced).encode(image);
+        }
+        QSaveFile object(index.root + "/objects/" + sha.toHex() + ".png");
+        if (png.isEmpty() || !object.open(QIODevice::WriteOnly) || object.write(png) != png.size() || !object.commit()) {
+            qDebug() << "CaptureArchive: Failed to store object";
+            return;
+        }
+        QFile file(index.root + "/index.bin");
+        if (!file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+            return;
+        }
+        if (file.size() == 0) {
+            QByteArray header(HeaderSize, 0);
+            memcpy(header.data(), Magic, sizeof(Magic));
+            qToLittleEndian(quint32(1), header.data() + 8);
+            file.write(header);
+            index.loadedBytes = HeaderSize;
+        }
+        QByteArray record(RecordSize, 0);
+        qToLittleEndian(hash, record.data());
+        memcpy(record.data() + 8, sha.constData(), 32);
+        qToLittleEndian(quint64(QDateTime::currentMSecsSinceEpoch()), record.data() + 40);
+        if (file.write(record) == RecordSize) {
+            index.insert({hash, sha});
+            index.loadedBytes += RecordSize;
+        }
+        kind = "stored";
+        target = sha;
+    }
+
+    QFile refs(index.root + "/refs.log");
+    if (refs.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        refs.write(QString("%1\t%2\t%3\t%4\n").arg(QDateTime::currentDateTime().toString(Qt::ISODate), name,
+                                                   QString::fromLatin1(target.toHex()), kind).toUtf8());
+    }
+    qDebug() << "CaptureArchive:" << name << kind << ", records:" << index.records.size()
+             << ", hash:" << hashMs << "ms, lookup:" << lookupMs << "ms";
+}
+
+void CaptureArchive::add(const QImage &image, const QString &name, const QByteArray &png)
+{
+    (void)QtConcurrent::run(archive, image, name, png);
+}
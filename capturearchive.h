@@ -0,0 +1,28 @@
+#ifndef CAPTUREARCHIVE_H
+#define CAPTUREARCHIVE_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QString>
+
+// 按内容寻址的导出归档（--archive 目录）。
+// 每次导出完成（写文件、复制到剪贴板、切片导出，任意格式）时计算合成结果的 SHA-256 和 64 位 dHash：
+//   完全相同的像素、或 dHash 汉明距离不超过 NearDistance 的近似图像，只在 refs.log 中记一条链接；
+//   否则把 PNG 存为 objects/<sha256>.png，并在 index.bin 末尾追加一条定长记录。
+// 太小或没有明暗变化的图像 dHash 没有区分度，只按 SHA-256 去重，记录中的 dHash 写 0，不参与近似查找。
+// 近似查找使用多索引哈希：64 位哈希分成 4 段 16 位，每段各建一张表，
+// 按鸽巢原理只需查询每段汉明距离 ≤ NearDistance / 4 的桶，十万条记录也只需访问几十个桶。
+class CaptureArchive {
+public:
+    static const int NearDistance = 5;
+
+    static void setRoot(const QString &dir); // 空字符串表示不归档
+    static bool isEnabled();
+    // 在后台线程执行；png 为空时由归档自己编码
+    static void add(const QImage &image, const QString &name, const QByteArray &png = QByteArray());
+
+    // 图像太小或没有明暗变化时返回 false，hash 置 0
+    static bool dHash(const QImage &image, quint64 &hash);
+};
+
+#endif // CAPTUREARCHIVE_H
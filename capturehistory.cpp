@@ -0,0 +1,186 @@
+#include "capturehistory.h"
+#include "shaperenderer.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QLockFile>
+#include <QPainter>
+#include <QStandardPaths>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QDebug>
+#include <cstring>
+#include <algorithm>
+
+static const char Magic[8] = {'S', 'S', 'H', 'O', 'T', 'H', 'I', 'X'};
+static const quint32 Version = 1;
+static const int HeaderSize = 64;
+static const int Capacity = 50;
+static const qint64 MaxTotalBytes = 512LL * 1024 * 1024;
+static const int ThumbWidth = 160;
+static const int ThumbHeight = 120;
+static const int SlotHeaderSize = 32;
+static const int SlotSize = (SlotHeaderSize + ThumbWidth * ThumbHeight * 4 + 63) / 64 * 64;
+static const qint64 IndexSize = HeaderSize + qint64(Capacity) * SlotSize;
+
+// 头：魔数、版本、容量、槽位大小、head
+// 槽位：id (创建时间毫秒，0 表示空)、文件字节数、宽、高、缩略图宽、缩略图高，随后是 RGB32 缩略图
+static quint64 slotId(const uchar *slot) { return qFromLittleEndian<quint64>(slot); }
+
+static QString entryPath(const QString &dir, quint64 id)
+{
+    return dir + QString("/%1.sshot").arg(id);
+}
+
+QString CaptureHistory::historyDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/history";
+}
+
+void CaptureHistory::add(const ProjectData &data)
+{
+    // 全局线程池在程序退出前会等待任务完成，交付后立即退出也不会丢失记录
+    (void)QtConcurrent::run(&CaptureHistory::write, data);
+}
+
+QImage CaptureHistory::makeThumbnail(const ProjectData &data)
+{
+    QImage thumbnail = data.capture.copy(data.viewport)
+                           .scaled(ThumbWidth, ThumbHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+                           .convertToFormat(QImage::Format_RGB32);
+    if (thumbnail.isNull() || data.shapes.isEmpty()) {
+        return thumbnail;
+    }
+    QPainter painter(&thumbnail);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(qreal(thumbnail.width()) / data.viewport.width(), qreal(thumbnail.height()) / data.viewport.height());
+    painter.translate(-data.viewport.topLeft());
+    ShapeRenderer::drawAll(painter, data.shapes);
+    return thumbnail;
+}
+
+void CaptureHistory::write(const ProjectData &data)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QString dir = historyDir();
+    QDir().mkpath(dir);
+
+    quint64 id = quint64(QDateTime::currentMSecsSinceEpoch());
+    QImage thumbnail = makeThumbnail(data);
+
+    // 多个编辑器或多个进程可能同时写历史
+    QLockFile lock(dir + "/index.lock");
+    if (!lock.lock()) {
+        return;
+    }
+    while (QFile::exists(entryPath(dir, id))) {
+        ++id;
+    }
+    QString filePath = entryPath(dir, id);
+    if (!ProjectFile::save(filePath, data, ProjectFile::Qoi)) {
+        return;
+    }
+
+    QFile index(dir + "/index.bin");
+    if (!index.open(QIODevice::ReadWrite)) {
+        return;
+    }
+    bool fresh = index.size() != IndexSize;
+    if (fresh && !index.resize(IndexSize)) {
+        return;
+    }
+    uchar *map = index.map(0, IndexSize);
+    if (!map) {
+        return;
+    }
+    if (fresh || memcmp(map, Magic, sizeof(Magic)) != 0 || qFromLittleEndian<quint32>(map + 8) != Version) {
+        memset(map, 0, IndexSize);
+        memcpy(map, Magic, sizeof(Magic));
+        qToLittleEndian(Version, map + 8);
+        qToLittleEndian(quint32(Capacity), map + 12);
+        qToLittleEndian(quint32(SlotSize), map + 16);
+    }
+
+    quint32 head = qFromLittleEndian<quint32>(map + 20) % Capacity;
+    uchar *slot = map + HeaderSize + qint64(head) * SlotSize;
+    if (slotId(slot) != 0) {
+        QFile::remove(entryPath(dir, slotId(slot))); // 环已满，覆盖最旧的记录
+    }
+    memset(slot, 0, SlotSize);
+    qToLittleEndian(id, slot);
+    qToLittleEndian(quint64(QFileInfo(filePath).size()), slot + 8);
+    qToLittleEndian(qint32(data.capture.width()), slot + 16);
+    qToLittleEndian(qint32(data.capture.height()), slot + 20);
+    qToLittleEndian(qint32(thumbnail.width()), slot + 24);
+    qToLittleEndian(qint32(thumbnail.height()), slot + 28);
+    for (int y = 0; y < thumbnail.height(); ++y) {
+        memcpy(slot + SlotHeaderSize + y * ThumbWidth * 4, thumbnail.constScanLine(y), thumbnail.width() * 4);
+    }
+    qToLittleEndian(quint32((head + 1) % Capacity), map + 20);
+
+    // 按总字节数裁剪：从最旧的开始删除，新写入的一条总是保留
+    forever {
+        qint64 total = 0;
+        uchar *oldest = nullptr;
+        for (int i = 0; i < Capacity; ++i) {
+            uchar *candidate = map + HeaderSize + qint64(i) * SlotSize;
+            if (slotId(candidate) == 0) {
+                continue;
+            }
+            total += qint64(qFromLittleEndian<quint64>(candidate + 8));
+            if (candidate != slot && (!oldest || slotId(candidate) < slotId(oldest))) {
+                oldest = candidate;
+            }
+        }
+        if (total <= MaxTotalBytes || !oldest) {
+            break;
+        }
+        QFile::remove(entryPath(dir, slotId(oldest)));
+        memset(oldest, 0, SlotHeaderSize);
+    }
+    index.unmap(map);
+
+    qDebug() << "CaptureHistory: Added" << filePath << ", time:" << timer.elapsed() << "ms";
+}
+
+QList<HistoryEntry> CaptureHistory::entries()
+{
+    QList<HistoryEntry> result;
+    QString dir = historyDir();
+    QLockFile lock(dir + "/index.lock");
+    if (!lock.tryLock(200)) {
+        return result;
+    }
+    QFile index(dir + "/index.bin");
+    if (!index.open(QIODevice::ReadOnly) || index.size() != IndexSize) {
+        return result;
+    }
+    const uchar *map = index.map(0, IndexSize);
+    if (!map || memcmp(map, Magic, sizeof(Magic)) != 0) {
+        return result;
+    }
+    for (int i = 0; i < Capacity; ++i) {
+        const uchar *slot = map + HeaderSize + qint64(i) * SlotSize;
+        quint64 id = slotId(slot);
+        if (id == 0) {
+            continue;
+        }
+        HistoryEntry entry;
+        entry.filePath = entryPath(dir, id);
+        entry.time = QDateTime::fromMSecsSinceEpoch(qint64(id));
+        entry.bytes = qint64(qFromLittleEndian<quint64>(slot + 8));
+        entry.size = QSize(qFromLittleEndian<qint32>(slot + 16), qFromLittleEndian<qint32>(slot + 20));
+        int thumbWidth = qBound(0, qFromLittleEndian<qint32>(slot + 24), ThumbWidth);
+        int thumbHeight = qBound(0, qFromLittleEndian<qint32>(slot + 28), ThumbHeight);
+        if (thumbWidth > 0 && thumbHeight > 0) {
+            entry.thumbnail = QImage(slot + SlotHeaderSize, thumbWidth, thumbHeight, ThumbWidth * 4, QImage::Format_RGB32).copy();
+        }
+        result.append(entry);
+    }
+    std::sort(result.begin(), result.end(), [](const HistoryEntry &a, const HistoryEntry &b) {
+        return a.time > b.time;
+    });
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef CAPTUREHISTORY_H
+#define CAPTUREHISTORY_H
+
+#include <QImage>
+#include <QDateTime>
+#include <QList>
+#include "projectfile.h"
+
+struct HistoryEntry {
+    QString filePath;   // 可直接用 ProjectFile::load 打开的 .sshot 文件
+    QDateTime time;
+    QSize size;         // 原始截图尺寸
+    qint64 bytes = 0;   // 项目文件大小
+    QImage thumbnail;
+};
+
+// 最近截图的磁盘历史。每条记录是一个 QOI 压缩的 .sshot 项目文件，
+// 另有一个定长槽位的缩略图索引 (index.bin)：固定 64 字节头 + 容量个槽位，
+// 每个槽位含时间、尺寸、文件大小和一张未压缩的缩略图，列表时整体映射，无需解码。
+// 索引是一个环：新记录写入 head 指向的槽位并覆盖最旧的一条；总字节数超限时继续删除最旧的。
+class CaptureHistory {
+public:
+    static void add(const ProjectData &data);   // 在后台线程写入，立即返回
+    static QList<HistoryEntry> entries();         // 最新的在前
+
+private:
+    static QString historyDir();
+    static void write(const ProjectData &data);
+    static QImage makeThumbnail(const ProjectData &data);
+};
+
+#endif // CAPTUREHISTORY_H
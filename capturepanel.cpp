@@ -0,0 +1,47 @@
+#include "capturepanel.h"
+#include <QWidget>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QDebug>
+
+static const int Gap = 8;
+
+QRect CapturePanel::place(QWidget *panel, const QRect &region)
+{
+    QScreen *screen = QGuiApplication::screenAt(region.center());
+    QRect available = (screen ? screen : QGuiApplication::primaryScreen())->availableGeometry();
+    const QSize size = panel->size();
+    auto clampX = [&](int x) {
+        return qBound(available.left(), x, available.right() - size.width() + 1);
+    };
+    auto clampY = [&](int y) {
+        return qBound(available.top(), y, available.bottom() - size.height() + 1);
+    };
+
+    const QPoint candidates[] = {
+        QPoint(clampX(region.right() - size.width() + 1), region.bottom() + 1 + Gap), // 下方，右对齐
+        QPoint(clampX(region.right() - size.width() + 1), region.top() - Gap - size.height()), // 上方
+        QPoint(region.right() + 1 + Gap, clampY(region.top())), // 右侧
+        QPoint(region.left() - Gap - size.width(), clampY(region.top())), // 左侧
+    };
+    for (const QPoint &pos : candidates) {
+        QRect rect(pos, size);
+        if (available.contains(rect) && !rect.intersects(region)) {
+            panel->move(pos);
+            return region;
+        }
+    }
+
+    // 四周都放不下：放在选区内的右下角，抓取区域在面板上方截止，面板不会被抓进画面
+    QRect inside = region & available;
+    QPoint pos(clampX(inside.right() - Gap - size.width() + 1), clampY(inside.bottom() - Gap - size.height() + 1));
+    panel->move(pos);
+    QRect grab = region;
+    grab.setBottom(pos.y() - Gap - 1);
+    if (grab.height() <= 0) {
+        qDebug() << "CapturePanel: Region too small to leave room for the panel:" << region;
+        return region;
+    }
+    qDebug() << "CapturePanel: No room outside" << region << ", panel placed inside, grabbing" << grab;
+    return grab;
+}
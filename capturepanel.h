@@ -0,0 +1,17 @@
+#ifndef CAPTUREPANEL_H
+#define CAPTUREPANEL_H
+
+#include <QRect>
+
+class QWidget;
+
+// 滚动截图、录制动画时控制面板的摆放：面板不能出现在被抓取的区域里。
+// 依次尝试选区的下方、上方、右侧、左侧；选区几乎占满屏幕、四周都放不下时，
+// 面板放在选区内的右下角，返回的抓取区域让出面板所在的那几行。
+class CapturePanel {
+public:
+    // panel 需已确定大小；返回实际应抓取的区域（全局坐标），面板在选区外时就是 region 本身
+    static QRect place(QWidget *panel, const QRect &region);
+};
+
+#endif // CAPTUREPANEL_H
@@ -0,0 +1,382 @@
+#include "colorquantizer.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QThread>
+#include <QVector>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+static const int HistogramSize = 32768; // 每通道 5 位
+static const double DefaultMaxError = 16.0; // 每通道均方误差，约等于均方根误差 4 个色阶
+static const qint64 ErrorSamples = 65536; // 估计量化误差时抽查的像素数
+
+static inline int binOf(QRgb pixel)
+{
+    return ((qRed(pixel) >> 3) << 10) | ((qGreen(pixel) >> 3) << 5) | (qBlue(pixel) >> 3);
+}
+
+static inline int binChannel(int bin, int channel)
+{
+    return (bin >> (10 - channel * 5)) & 31;
+}
+
+// 一个行带的直方图，各行带并行统计后再合并
+struct HistogramBand {
+    int firstRow = 0;
+    int rowCount = 0;
+    QVector<quint32> counts;
+    QVector<quint64> sums; // 每个格子 r、g、b 三个分量之和
+};
+
+struct ColorBox {
+    QVector<int> bins;
+    quint64 count = 0;
+    int minimum[3] = {31, 31, 31};
+    int maximum[3] = {0, 0, 0};
+};
+
+static void countBand(HistogramBand &band, const QImage &image)
+{
+    band.counts.fill(0, HistogramSize);
+    band.sums.fill(0, HistogramSize * 3);
+    quint32 *counts = band.counts.data();
+    quint64 *sums = band.sums.data();
+    int width = image.width();
+    for (int y = band.firstRow; y < band.firstRow + band.rowCount; ++y) {
+        const QRgb *row = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            QRgb pixel = row[x];
+            int bin = binOf(pixel);
+            ++counts[bin];
+            sums[bin * 3] += qRed(pixel);
+            sums[bin * 3 + 1] += qGreen(pixel);
+            sums[bin * 3 + 2] += qBlue(pixel);
+        }
+    }
+}
+
+static void updateBounds(ColorBox &box, const QVector<quint32> &counts)
+{
+    box.count = 0;
+    for (int c = 0; c < 3; ++c) {
+        box.minimum[c] = 31;
+        box.maximum[c] = 0;
+    }
+    for (int bin : box.bins) {
+        box.count += counts[bin];
+        for (int c = 0; c < 3; ++c) {
+            int value = binChannel(bin, c);
+            box.minimum[c] = qMin(box.minimum[c], value);
+            box.maximum[c] = qMax(box.maximum[c], value);
+        }
+    }
+}
+
+static int longestChannel(const ColorBox &box)
+{
+    int channel = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (box.maximum[c] - box.minimum[c] > box.maximum[channel] - box.minimum[channel]) {
+            channel = c;
+        }
+    }
+    return channel;
+}
+
+// 中位切分：反复选择“像素数 × 最长边”最大的盒子，在最长的通道上按像素数的中位数一分为二
+static QVector<ColorBox> medianCut(const QVector<quint32> &counts, int maxColors)
+{
+    QVector<ColorBox> boxes(1);
+    for (int bin = 0; bin < HistogramSize; ++bin) {
+        if (counts[bin] > 0) {
+            boxes[0].bins.append(bin);
+        }
+    }
+    updateBounds(boxes[0], counts);
+
+    while (boxes.size() < maxColors) {
+        int target = -1;
+        quint64 bestScore = 0;
+        for (int i = 0; i < boxes.size(); ++i) {
+            const ColorBox &box = boxes[i];
+            if (box.bins.size() < 2) {
+                continue;
+            }
+            int channel = longestChannel(box);
+            quint64 score = box.count * quint64(box.maximum[channel] - box.minimum[channel] + 1);
+            if (score > bestScore) {
+                bestScore = score;
+                target = i;
+            }
+        }
+        if (target < 0) {
+            break;
+        }
+
+        ColorBox &box = boxes[target];
+        int channel = longestChannel(box);
+        std::sort(box.bins.begin(), box.bins.end(), [channel](int a, int b) {
+            return binChannel(a, channel) < binChannel(b, channel);
+        });
+        quint64 half = box.count / 2;
+        quint64 accumulated = 0;
+        int split = 1;
+        for (int i = 0; i < box.bins.size() - 1; ++i) {
+            accumulated += counts[box.bins[i]];
+            split = i + 1;
+            if (accumulated >= half) {
+                break;
+            }
+        }
+
+        ColorBox upper;
+        upper.bins = box.bins.mid(split);
+        box.bins.resize(split);
+        updateBounds(box, counts);
+        updateBounds(upper, counts);
+        boxes.append(upper);
+    }
+    return boxes;
+}
+
+static inline int distance(int r1, int g1, int b1, QRgb color)
+{
+    int dr = r1 - qRed(color);
+    int dg = g1 - qGreen(color);
+    int db = b1 - qBlue(color);
+    return dr * dr + dg * dg + db * db;
+}
+
+static int nearestColor(int r, int g, int b, const QVector<QRgb> &palette)
+{
+    int best = 0;
+    int bestDistance = INT_MAX;
+    for (int i = 0; i < palette.size(); ++i) {
+        int d = distance(r, g, b, palette[i]);
+        if (d < bestDistance) {
+            bestDistance = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// 颜色数不超过上限时直接建立精确调色板；超过上限返回空图像
+static QImage exactPalette(const QImage &image, int maxColors)
+{
+    QHash<QRgb, int> indices;
+    QVector<QRgb> palette;
+    QImage indexed(image.size(), QImage::Format_Indexed8);
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *row = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        uchar *out = indexed.scanLine(y);
+        QRgb last = 0;
+        int lastIndex = -1;
+        for (int x = 0; x < image.width(); ++x) {
+            QRgb pixel = row[x];
+            if (pixel != last || lastIndex < 0) {
+                auto it = indices.constFind(pixel);
+                if (it != indices.constEnd()) {
+                    lastIndex = it.value();
+                } else {
+                    if (palette.size() == maxColors) {
+                        return QImage();
+                    }
+                    lastIndex = palette.size();
+                    indices.insert(pixel, lastIndex);
+                    palette.append(pixel);
+                }
+                last = pixel;
+            }
+            out[x] = uchar(lastIndex);
+        }
+    }
+    indexed.setColorTable(palette);
+    return indexed;
+}
+
+static void ditherImage(const QImage &source, QImage &indexed, const QVector<QRgb> &palette, const QVector<uchar> &lookup)
+{
+    int width = source.width();
+    // 当前行和下一行的误差，每个像素 3 个通道，两侧各留一个像素的边界
+    QVector<int> current((width + 2) * 3, 0);
+    QVector<int> next((width + 2) * 3, 0);
+    for (int y = 0; y < source.height(); ++y) {
+        const QRgb *row = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        uchar *out = indexed.scanLine(y);
+        next.fill(0);
+        for (int x = 0; x < width; ++x) {
+            int *error = current.data() + (x + 1) * 3;
+            int r = qBound(0, qRed(row[x]) + error[0] / 16, 255);
+            int g = qBound(0, qGreen(row[x]) + error[1] / 16, 255);
+            int b = qBound(0, qBlue(row[x]) + error[2] / 16, 255);
+            int index = lookup[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+            out[x] = uchar(index);
+
+            int diff[3] = {r - qRed(palette[index]), g - qGreen(palette[index]), b - qBlue(palette[index])};
+            int *below = next.data() + (x + 1) * 3;
+            for (int c = 0; c < 3; ++c) {
+                error[3 + c] += diff[c] * 7;
+                below[-3 + c] += diff[c] * 3;
+                below[c] += diff[c] * 5;
+                below[3 + c] += diff[c];
+            }
+        }
+        std::swap(current, next);
+    }
+}
+
+// 在均匀分布的网格上抽查真实像素，按实际使用的查找表映射到调色板后计算每通道均方误差。
+// 不能用格子平均色代替像素：同一格子内的像素分布在最多 8 个色阶的范围内，平均色会低估误差
+static double sampledError(const QImage &source, const QVector<QRgb> &palette, const QVector<uchar> &lookup)
+{
+    const qint64 pixels = qint64(source.width()) * source.height();
+    const int step = qMax(1, int(std::sqrt(double(pixels) / ErrorSamples)));
+    double squaredError = 0;
+    qint64 sampled = 0;
+    for (int y = step / 2; y < source.height(); y += step) {
+        const QRgb *row = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        for (int x = step / 2; x < source.width(); x += step) {
+            QRgb pixel = row[x];
+            squaredError += distance(qRed(pixel), qGreen(pixel), qBlue(pixel), palette[lookup[binOf(pixel)]]);
+            ++sampled;
+        }
+    }
+    return sampled > 0 ? squaredError / (double(sampled) * 3) : 0.0;
+}
+
+ColorQuantizer::ColorQuantizer(int maxColors, bool dither)
+    : maxColors(qBound(2, maxColors, 256))
+    , dither(dither)
+    , maxError(DefaultMaxError)
+{
+}
+
+QImage ColorQuantizer::quantize(const QImage &image) const
+{
+    if (image.isNull()) {
+        return QImage();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    double megapixels = double(image.width()) * image.height() / 1e6;
+
+    QImage source = image;
+    if (source.format() != QImage::Format_RGB32 && source.format() != QImage::Format_ARGB32) {
+        source = source.convertToFormat(source.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+    if (source.format() == QImage::Format_RGB32) {
+        // RGB32 的最高字节未定义，统一成不透明，避免同一颜色被当成不同颜色
+        source = source.convertToFormat(QImage::Format_ARGB32);
+    }
+
+    QImage indexed = exactPalette(source, maxColors);
+    if (!indexed.isNull()) {
+        qDebug() << "ColorQuantizer: Exact palette," << indexed.colorCount() << "colors, time:" << timer.elapsed()
+                 << "ms (" << (megapixels > 0 ? timer.elapsed() / megapixels : 0.0) << "ms/MP)";
+        return indexed;
+    }
+
+    // 有透明像素且颜色过多时，中位切分只处理 RGB，不如直接按真彩色编码
+    if (image.hasAlphaChannel()) {
+        for (int y = 0; y < source.height(); ++y) {
+            const QRgb *row = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+            for (int x = 0; x < source.width(); ++x) {
+                if (qAlpha(row[x]) != 255) {
+                    qDebug() << "ColorQuantizer: Translucent image with too many colors, keeping truecolor";
+                    return QImage();
+                }
+            }
+        }
+    }
+
+    // 按行带并行统计直方图
+    int threads = qMax(1, QThread::idealThreadCount());
+    int rowsPerBand = qMax(1, (source.height() + threads - 1) / threads);
+    QVector<HistogramBand> bands;
+    for (int y = 0; y < source.height(); y += rowsPerBand) {
+        HistogramBand band;
+        band.firstRow = y;
+        band.rowCount = qMin(rowsPerBand, source.height() - y);
+        bands.append(band);
+    }
+    QtConcurrent::blockingMap(bands, [&source](HistogramBand &band) {
+        countBand(band, source);
+    });
+    QVector<quint32> counts(HistogramSize, 0);
+    QVector<quint64> sums(HistogramSize * 3, 0);
+    for (const HistogramBand &band : bands) {
+        for (int i = 0; i < HistogramSize; ++i) {
+            counts[i] += band.counts[i];
+        }
+        for (int i = 0; i < HistogramSize * 3; ++i) {
+            sums[i] += band.sums[i];
+        }
+    }
+
+    // 中位切分，每个盒子取其中像素的平均色
+    QVector<ColorBox> boxes = medianCut(counts, maxColors);
+    QVector<QRgb> palette;
+    for (const ColorBox &box : boxes) {
+        quint64 total[3] = {0, 0, 0};
+        for (int bin : box.bins) {
+            for (int c = 0; c < 3; ++c) {
+                total[c] += sums[bin * 3 + c];
+            }
+        }
+        quint64 n = qMax<quint64>(1, box.count);
+        palette.append(qRgb(int(total[0] / n), int(total[1] / n), int(total[2] / n)));
+    }
+
+    // 每个直方图格子映射到离格子平均色最近的调色板颜色
+    QVector<uchar> lookup(HistogramSize, 0);
+    for (int bin = 0; bin < HistogramSize; ++bin) {
+        int r, g, b;
+        if (counts[bin] > 0) {
+            r = int(sums[bin * 3] / counts[bin]);
+            g = int(sums[bin * 3 + 1] / counts[bin]);
+            b = int(sums[bin * 3 + 2] / counts[bin]);
+        } else {
+            r = (binChannel(bin, 0) << 3) | 4;
+            g = (binChannel(bin, 1) << 3) | 4;
+            b = (binChannel(bin, 2) << 3) | 4;
+        }
+        lookup[bin] = uchar(nearestColor(r, g, b, palette));
+    }
+    double meanSquaredError = sampledError(source, palette, lookup);
+    if (meanSquaredError > maxError) {
+        qDebug() << "ColorQuantizer: Error" << meanSquaredError << "exceeds" << maxError << ", keeping truecolor, time:" << timer.elapsed() << "ms";
+        return QImage();
+    }
+
+    indexed = QImage(source.size(), QImage::Format_Indexed8);
+    indexed.setColorTable(palette);
+    if (dither) {
+        ditherImage(source, indexed, palette, lookup);
+    } else {
+        for (HistogramBand &band : bands) {
+            band.counts.clear();
+            band.sums.clear();
+        }
+        const uchar *table = lookup.constData();
+        uchar *bits = indexed.bits();
+        qsizetype bytesPerLine = indexed.bytesPerLine();
+        QtConcurrent::blockingMap(bands, [&source, bits, bytesPerLine, table](HistogramBand &band) {
+            for (int y = band.firstRow; y < band.firstRow + band.rowCount; ++y) {
+                const QRgb *row = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+                uchar *out = bits + y * bytesPerLine;
+                for (int x = 0; x < source.width(); ++x) {
+                    out[x] = table[binOf(row[x])];
+                }
+            }
+        });
+    }
+
+    qDebug() << "ColorQuantizer: Median cut," << palette.size() << "colors, error:" << meanSquaredError
+             << ", dither:" << dither << ", time:" << timer.elapsed()
+             << "ms (" << (megapixels > 0 ? timer.elapsed() / megapixels : 0.0) << "ms/MP)";
+    return indexed;
+}
@@ -0,0 +1,25 @@
+#ifndef COLORQUANTIZER_H
+#define COLORQUANTIZER_H
+
+#include <QImage>
+
+// 调色板量化：把真彩色截图转换成最多 256 色的 Indexed8 图像，供 PngEncoder 写出索引色 PNG。
+// 颜色数不超过上限时直接使用精确调色板（界面截图的常见情况，无损）；
+// 否则在 15 位颜色直方图上做中位切分，可选 Floyd-Steinberg 抖动。
+// 抽查真实像素得到的量化误差超过阈值时放弃量化，调用方应按真彩色编码。
+class ColorQuantizer {
+public:
+    explicit ColorQuantizer(int maxColors = 256, bool dither = false);
+
+    void setMaxError(double meanSquaredError) { maxError = meanSquaredError; }
+
+    // 返回 Indexed8 图像；不适合量化时返回空图像
+    QImage quantize(const QImage &image) const;
+
+private:
+    int maxColors;
+    bool dither;
+    double maxError;
+};
+
+#endif // COLORQUANTIZER_H
@@ -0,0 +1,258 @@
+#include "damagetracker.h"
+#include <QThread>
+#include <QRegion>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cstring>
+
+#ifdef HAVE_XDAMAGE
+// Xlib 的头文件定义了 None、Bool 等宏，只在这里、放在 Qt 头文件之后包含
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xdamage.h>
+#ifdef HAVE_XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+#include <poll.h>
+#endif
+
+static const int MaxReadRects = 64;       // 损坏区域过于零碎时改读外接矩形，减少往返次数
+static const int ReportIntervalMs = 5000;
+
+DamageTracker::DamageTracker()
+{
+}
+
+DamageTracker::~DamageTracker()
+{
+    if (thread) {
+        stopping.storeRelease(1);
+        thread->wait();
+        delete thread;
+    }
+}
+
+void DamageTracker::start()
+{
+    if (thread) {
+        return;
+    }
+    thread = QThread::create([this]() {
+        run();
+    });
+    thread->start(QThread::LowPriority);
+}
+
+QSize DamageTracker::size()
+{
+    QMutexLocker locker(&mutex);
+    return framebuffer.size();
+}
+
+bool DamageTracker::copyTo(QImage &target)
+{
+    QMutexLocker locker(&mutex);
+    if (framebuffer.isNull() || target.size() != framebuffer.size() || target.depth() != framebuffer.depth()) {
+        return false;
+    }
+    const qsizetype rowBytes = qsizetype(framebuffer.width()) * 4;
+    for (int y = 0; y < framebuffer.height(); ++y) {
+        memcpy(target.scanLine(y), framebuffer.constScanLine(y), rowBytes);
+    }
+    return true;
+}
+
+#ifdef HAVE_XDAMAGE
+
+// Xlib 默认的错误处理会直接退出进程。屏幕分辨率刚变化时读取旧尺寸的区域会得到 BadMatch，
+// 窗口销毁等也会产生异步错误；这里只记录下来，出错的读取返回空，下一次读取会补上。
+// 错误处理函数是整个进程共用的，跟踪线程运行期间一直安装着（异步错误随时可能到达），
+// 所以只处理跟踪线程自己的连接，其它 Display 上的错误仍交给原来的处理函数
+static QAtomicInt lastXError{0};
+static QAtomicPointer<Display> trackerDisplay;
+static XErrorHandler previousXErrorHandler = nullptr;
+
+static int recordXError(Display *display, XErrorEvent *event)
+{
+    if (display != trackerDisplay.loadAcquire() && previousXErrorHandler) {
+        return previousXErrorHandler(display, event);
+    }
+    lastXError.storeRelaxed(event->error_code);
+    return 0;
+}
+
+// 读取根窗口上的一个矩形到帧缓冲，返回读取的字节数
+static qint64 readArea(Display *display, Window root, const QRect &area, QImage &framebuffer, QMutex &mutex)
+{
+    XImage *image = XGetImage(display, root, area.x(), area.y(), uint(area.width()), uint(area.height()), AllPlanes, ZPixmap);
+    if (!image) {
+        qDebug() << "DamageTracker: Failed to read" << area << ", X error" << lastXError.loadRelaxed();
+        return 0;
+    }
+    qint64 bytes = 0;
+    if (image->bits_per_pixel == 32) {
+        QMutexLocker locker(&mutex);
+        // 读取期间尺寸可能已经变化，超出当前帧缓冲的部分不写
+        if (QRect(QPoint(0, 0), framebuffer.size()).contains(area)) {
+            const int rowBytes = area.width() * 4;
+            for (int y = 0; y < area.height(); ++y) {
+                memcpy(framebuffer.scanLine(area.y() + y) + area.x() * 4, image->data + qsizetype(y) * image->bytes_per_line, rowBytes);
+            }
+            bytes = qint64(rowBytes) * area.height();
+        }
+    }
+    XDestroyImage(image);
+    return bytes;
+}
+
+// 重新查询根窗口尺寸，重建帧缓冲并整屏读取一次；返回新的范围，失败时返回空矩形
+static QRect resetFramebuffer(Display *display, Window root, QImage &framebuffer, QMutex &mutex)
+{
+    XWindowAttributes attributes{};
+    if (!XGetWindowAttributes(display, root, &attributes) || attributes.depth < 24) {
+        qDebug() << "DamageTracker: Unsupported root window, depth" << attributes.depth;
+        return QRect();
+    }
+    const QRect bounds(0, 0, attributes.width, attributes.height);
+    {
+        QMutexLocker locker(&mutex);
+        framebuffer = QImage(bounds.size(), QImage::Format_RGB32);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    readArea(display, root, bounds, framebuffer, mutex);
+    qDebug() << "DamageTracker: Full read of" << bounds.size() << "took" << timer.elapsed() << "ms";
+    return bounds;
+}
+
+void DamageTracker::run()
+{
+    Display *display = XOpenDisplay(nullptr);
+    int eventBase = 0;
+    int errorBase = 0;
+    if (!display || !XDamageQueryExtension(display, &eventBase, &errorBase)) {
+        qDebug() << "DamageTracker: XDamage is not available";
+        if (display) {
+            XCloseDisplay(display);
+        }
+        return;
+    }
+    trackerDisplay.storeRelease(display);
+    previousXErrorHandler = XSetErrorHandler(recordXError);
+    Window root = DefaultRootWindow(display);
+    // 根窗口尺寸变化（RandR 切换分辨率、接上显示器）时重建帧缓冲
+    XSelectInput(display, root, StructureNotifyMask);
+    int randrEventBase = -1;
+#ifdef HAVE_XRANDR
+    int randrErrorBase = 0;
+    if (XRRQueryExtension(display, &randrEventBase, &randrErrorBase)) {
+        XRRSelectInput(display, root, RRScreenChangeNotifyMask);
+    } else {
+        randrEventBase = -1;
+    }
+#endif
+    QRect bounds = resetFramebuffer(display, root, framebuffer, mutex);
+    if (bounds.isEmpty()) {
+        XSync(display, False);
+        XSetErrorHandler(previousXErrorHandler);
+        trackerDisplay.storeRelease(nullptr);
+        XCloseDisplay(display);
+        return;
+    }
+    // 每个损坏矩形单独上报，不需要再用 XFixes 区域查询
+    Damage damage = XDamageCreate(display, root, XDamageReportRawRectangles);
+    available.storeRelease(1);
+
+    QRegion dirty;
+    bool resized = false;
+    QElapsedTimer sinceRead;
+    sinceRead.start();
+    QElapsedTimer sinceReport;
+    sinceReport.start();
+    qint64 bytes = 0;
+    qint64 reads = 0;
+    qint64 events = 0;
+    pollfd fd;
+    fd.fd = ConnectionNumber(display);
+    fd.events = POLLIN;
+    while (!stopping.loadAcquire()) {
+        if (!XPending(display)) {
+            // 有待读的区域时只等到下一次读取，否则最多等 100ms 再检查是否要退出
+            int timeout = dirty.isEmpty() ? 100 : qMax(0, ReadIntervalMs - int(sinceRead.elapsed()));
+            poll(&fd, 1, timeout);
+        }
+        while (XPending(display)) {
+            XEvent event;
+            XNextEvent(display, &event);
+            if (event.type == eventBase + XDamageNotify) {
+                const XDamageNotifyEvent *notify = reinterpret_cast<const XDamageNotifyEvent *>(&event);
+                dirty += QRect(notify->area.x, notify->area.y, notify->area.width, notify->area.height) & bounds;
+                ++events;
+            } else if (event.type == ConfigureNotify && event.xconfigure.window == root) {
+                resized = resized || event.xconfigure.width != bounds.width() || event.xconfigure.height != bounds.height();
+            }
+#ifdef HAVE_XRANDR
+            else if (randrEventBase >= 0 && event.type == randrEventBase + RRScreenChangeNotify) {
+                XRRUpdateConfiguration(&event);
+                resized = true;
+            }
+#endif
+        }
+        if (resized) {
+            // 旧尺寸的损坏区域作废，整屏重读一次
+            available.storeRelease(0);
+            XDamageSubtract(display, damage, 0, 0);
+            bounds = resetFramebuffer(display, root, framebuffer, mutex);
+            if (bounds.isEmpty()) {
+                break;
+            }
+            available.storeRelease(1);
+            dirty = QRegion();
+            resized = false;
+            sinceRead.restart();
+            continue;
+        }
+        if (!dirty.isEmpty() && sinceRead.elapsed() >= ReadIntervalMs) {
+            // 先清空服务器端累积的损坏，之后的绘制会产生新的事件，不会漏掉
+            XDamageSubtract(display, damage, 0, 0);
+            if (dirty.rectCount() > MaxReadRects) {
+                bytes += readArea(display, root, dirty.boundingRect(), framebuffer, mutex);
+                ++reads;
+            } else {
+                for (const QRect &rect : dirty) {
+                    bytes += readArea(display, root, rect, framebuffer, mutex);
+                    ++reads;
+                }
+            }
+            dirty = QRegion();
+            sinceRead.restart();
+        }
+        if (sinceReport.elapsed() >= ReportIntervalMs) {
+            // 同时换算成每秒相当于多少次整屏读取，便于和每次整屏抓取的方案比较
+            double seconds = sinceReport.elapsed() / 1000.0;
+            double fullFrames = bytes / (double(bounds.width()) * bounds.height() * 4) / seconds;
+            qDebug() << "DamageTracker: Re-read" << qint64(bytes / 1024 / seconds) << "KB/s (" << fullFrames
+                     << "full frames/s) in" << qint64(reads / seconds) << "reads/s from" << qint64(events / seconds)
+                     << "damage events/s";
+            bytes = 0;
+            reads = 0;
+            events = 0;
+            sinceReport.restart();
+        }
+    }
+    available.storeRelease(0);
+    XDamageDestroy(display, damage);
+    XSync(display, False);
+    XSetErrorHandler(previousXErrorHandler);
+    trackerDisplay.storeRelease(nullptr);
+    XCloseDisplay(display);
+}
+
+#else
+
+void DamageTracker::run()
+{
+    qDebug() << "DamageTracker: Built without XDamage support";
+}
+
+#endif
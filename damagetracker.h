@@ -0,0 +1,36 @@
+#ifndef DAMAGETRACKER_H
+#define DAMAGETRACKER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QAtomicInt>
+
+class QThread;
+
+// 常驻模式下的预抓取：后台线程用 X11 的 XDamage 扩展监听根窗口上发生变化的区域，
+// 只重新读取这些区域，始终保持一份最新的整屏帧缓冲。触发截图时用 copyTo() 直接复制这份缓冲，
+// 不再等待整屏抓取。每 5 秒在日志中输出重新读取的字节数，用于比较空闲和繁忙时的开销。
+// 编译时没有 XDamage（定义 HAVE_XDAMAGE）或运行时连不上 X 服务器时 isAvailable() 为 false。
+class DamageTracker {
+public:
+    DamageTracker();
+    ~DamageTracker();
+
+    void start();
+    bool isAvailable() const { return available.loadAcquire(); }
+    QSize size(); // 整个根窗口（所有屏幕）的尺寸，不可用时为空
+    bool copyTo(QImage &target); // 复制到调用方提供的缓冲（例如共享内存），尺寸必须与 size() 相同
+
+    static const int ReadIntervalMs = 16; // 累积一段时间的损坏区域再读，连续的小改动合并成一次读取
+
+private:
+    QThread *thread = nullptr;
+    QAtomicInt stopping{0};
+    QAtomicInt available{0};
+    QMutex mutex;
+    QImage framebuffer;
+
+    void run();
+};
+
+#endif // DAMAGETRACKER_H
@@ -2,36 +2,105 @@
 #include "mainwindow.h"
 #include "toolbarwindow.h"
 #include "sizedisplaywindow.h"
+#include "shaperenderer.h"
+#include "sizeestimator.h"
+#include "sessionjournal.h"
+#include "capturehistory.h"
+#include "pixeldiff.h"
+#include "patchfinder.h"
+#include "textregiondetector.h"
+#include "scrollcapturewindow.h"
+#include "recordwindow.h"
+#include "qoicodec.h"
 #include <QPainter>
 #include <QDebug>
 #include <QInputDialog>
 #include <QCursor>
 #include <QApplication>
-#include <QClipboard>
 #include <cmath>
-#include <QTimer>
 #include <QThread>
 #include <QPainterPath>
+#include <QFileDialog>
+#include <QDateTime>
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cstring>
 
 
-EditWindow::EditWindow(const QPixmap &screenshot, const QPoint &pos, QWidget *parent)
-    : QWidget(parent), screenshot(screenshot), canvas(screenshot), drawingLayer(screenshot.size()), tempLayer(screenshot.size())
+// 把图层内容整体平移 delta 像素，移出的部分丢弃，露出的部分清成透明
+static void scrollLayer(QImage &layer, const QPoint &delta)
+{
+    const int width = layer.width();
+    const int height = layer.height();
+    const int bytesPerPixel = layer.depth() / 8;
+    const int dx = delta.x();
+    const int dy = delta.y();
+    if (qAbs(dx) >= width || qAbs(dy) >= height) {
+        layer.fill(Qt::transparent);
+        return;
+    }
+    const int keptBytes = (width - qAbs(dx)) * bytesPerPixel;
+    const int exposedBytes = qAbs(dx) * bytesPerPixel;
+    // 向下平移时从底部开始逐行复制，避免覆盖还没读到的源行
+    for (int i = 0; i < height; ++i) {
+        const int y = dy > 0 ? height - 1 - i : i;
+        uchar *row = layer.scanLine(y);
+        const int sourceY = y - dy;
+        if (sourceY < 0 || sourceY >= height) {
+            memset(row, 0, size_t(width) * bytesPerPixel);
+            continue;
+        }
+        const uchar *source = layer.constScanLine(sourceY);
+        memmove(row + qMax(dx, 0) * bytesPerPixel, source + qMax(-dx, 0) * bytesPerPixel, keptBytes);
+        memset(dx > 0 ? row : row + keptBytes, 0, exposedBytes);
+    }
+}
+
+EditWindow::EditWindow(const QPixmap &capture, const QRect &selection, QWidget *parent)
+    : QWidget(parent), capture(capture), viewport(selection)
 {
+    // 截图还在后台解码时先用占位图打开，稍后由 setCapture 替换
+    if (capture.isNull()) {
+        this->capture = QPixmap(selection.right() + 1, selection.bottom() + 1);
+        this->capture.fill(Qt::lightGray);
+    }
+    drawingLayerPool.setLimit(capture.size());
+    tempLayerPool.setLimit(capture.size());
+    drawingLayer = drawingLayerPool.acquire(selection.size());
+    tempLayer = tempLayerPool.acquire(selection.size());
+
     setWindowFlags(Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::SubWindow); // 使用 SubWindow 隐藏任务栏
-    setFixedSize(screenshot.size());
-    move(pos);
+    setFixedSize(selection.size());
+    move(selection.topLeft());
     setMouseTracking(true);
     drawingLayer.fill(Qt::transparent);
     tempLayer.fill(Qt::transparent);
+    QImage captureImage = capture.isNull() ? QImage() : capture.toImage();
+    journal = new SessionJournal(captureImage, selection);
+    sizeEstimator = new SizeEstimator(this);
+    sizeEstimator->setCapture(captureImage);
+    connect(&suggestionWatcher, &QFutureWatcher<QList<QRect>>::finished, this, [this]() {
+        suggestions = suggestionWatcher.result();
+        update();
+    });
+    connect(&similarWatcher, &QFutureWatcher<QList<QRect>>::finished, this, &EditWindow::applySimilarMasks);
+    analyzeSuggestions(captureImage);
     updateCanvas();
     toolBar = new ToolBarWindow(this, this);
     toolBar->show();
+    exportPipeline = new ExportPipeline(this);
 
     sizeDisplayWindow = new SizeDisplayWindow(this);
-    QString sizeText = QString("%1x%2").arg(screenshot.width()).arg(screenshot.height());
+    QString sizeText = QString("%1x%2").arg(selection.width()).arg(selection.height());
     sizeDisplayWindow->setSizeText(sizeText);
     sizeDisplayWindow->show();
     updateSizeDisplayPosition();
+    connect(sizeEstimator, &SizeEstimator::estimateReady, this, [this](qint64 bytes) {
+        sizeDisplayWindow->setEstimatedBytes(bytes);
+        updateSizeDisplayPosition();
+    });
 
     mode = -1;
     isDragMode = true;
@@ -50,8 +119,13 @@ EditWindow::EditWindow(const QPixmap &screenshot, const QPoint &pos, QWidget *pa
         qDebug() << "EditWindow: Drag mode:" << isDragMode;
     });
     connect(toolBar, &ToolBarWindow::undoRequested, this, [this]() {
-        if (!shapes.isEmpty()) {
+        if (mode == 7 && !slices.isEmpty()) {
+            slices.removeLast();
+            journal->setSlices(slices);
+            update();
+        } else if (!shapes.isEmpty()) {
             shapes.removeLast();
+            journal->removeLastShape();
             updateCanvas();
             update();
         }
@@ -62,38 +136,68 @@ EditWindow::EditWindow(const QPixmap &screenshot, const QPoint &pos, QWidget *pa
             qDebug() << "不在主线程中！";
             return;
         }
-        QClipboard *clipboard = QApplication::clipboard();
-        bool settingPixmap = true;
-
-        connect(clipboard, &QClipboard::dataChanged, this, [this, clipboard, settingPixmap]() {
-            if (settingPixmap) {
-                QPixmap pixmap = clipboard->pixmap();
-                if (!pixmap.isNull() && pixmap.size() == canvas.size()) {
-                    qDebug() << "11";
-                    QTimer::singleShot(100, qApp, &QApplication::quit);
-                } else {
-                    qDebug() << "22";
-                }
-            } else {
-                if (clipboard->text() == "Hello, world!") {
-                    qDebug() << "01";
-                } else {
-                    qDebug() << "02";
-                }
+        startExport(createExportJob());
+    });
+    connect(toolBar, &ToolBarWindow::saveRequested, this, [this]() {
+        if (exportPipeline->isRunning()) {
+            return;
+        }
+        // 文件类型过滤器同时用来选择 PNG 压缩预设
+        const QString balancedFilter = "PNG - 均衡 (*.png)";
+        const QString fastestFilter = "PNG - 最快 (*.png)";
+        const QString smallestFilter = "PNG - 最小 (*.png)";
+        const QString paletteFilter = "PNG - 调色板 (*.png)";
+        const QString ditherFilter = "PNG - 调色板+抖动 (*.png)";
+        const QString qoiFilter = "QOI - 快速无损 (*.qoi)";
+        const QString pdfFilter = "PDF - 矢量标注 (*.pdf)";
+        const QString svgFilter = "SVG - 矢量标注 (*.svg)";
+        QString selectedFilter = balancedFilter;
+        QString defaultName = QDateTime::currentDateTime().toString("'screenshot_'yyyyMMdd_HHmmss'.png'");
+        QString filePath = QFileDialog::getSaveFileName(this, "保存截图", QDir::home().filePath(defaultName),
+                                                        QStringList({balancedFilter, fastestFilter, smallestFilter, paletteFilter, ditherFilter, qoiFilter, pdfFilter, svgFilter}).join(";;"),
+                                                        &selectedFilter);
+        if (filePath.isEmpty()) {
+            return;
+        }
+        ExportJob job = createExportJob();
+        job.filePath = filePath;
+        // 选择了其他格式但文件名仍是默认的 .png 时，替换扩展名
+        auto setSuffix = [&job, &filePath](const QString &suffix) {
+            if (filePath.endsWith(".png", Qt::CaseInsensitive)) {
+                filePath.chop(4);
+                filePath += suffix;
+                job.filePath = filePath;
             }
-            disconnect(clipboard, &QClipboard::dataChanged, this, nullptr);
-        });
-
-        if (settingPixmap) {
-            QImage image = canvas.toImage();
-            clipboard->setImage(image);
-        } else {
-            clipboard->setText("Hello, world!");
+        };
+        if (selectedFilter == qoiFilter || filePath.endsWith(".qoi", Qt::CaseInsensitive)) {
+            job.format = ExportJob::Qoi;
+            setSuffix(".qoi");
+        } else if (selectedFilter == pdfFilter || filePath.endsWith(".pdf", Qt::CaseInsensitive)) {
+            job.format = ExportJob::Pdf;
+            setSuffix(".pdf");
+        } else if (selectedFilter == svgFilter || filePath.endsWith(".svg", Qt::CaseInsensitive)) {
+            job.format = ExportJob::Svg;
+            setSuffix(".svg");
+        } else if (selectedFilter == fastestFilter) {
+            job.pngPreset = PngEncoder::Fastest;
+        } else if (selectedFilter == smallestFilter) {
+            job.pngPreset = PngEncoder::Smallest;
+        } else if (selectedFilter == paletteFilter || selectedFilter == ditherFilter) {
+            job.quantize = true;
+            job.dither = selectedFilter == ditherFilter;
         }
+        startExport(job);
+    });
+    connect(exportPipeline, &ExportPipeline::delivered, this, &EditWindow::sessionEnded);
+    connect(exportPipeline, &ExportPipeline::failed, this, [this](const QString &reason) {
+        qDebug() << "EditWindow: Export failed:" << reason;
+        emit sessionEnded();
     });
 
-    connect(toolBar, &ToolBarWindow::cancelRequested, this, []() {
-        QCoreApplication::quit();
+    connect(toolBar, &ToolBarWindow::cancelRequested, this, [this]() {
+        hide();
+        hideToolBar();
+        emit sessionEnded();
     });
     connect(toolBar, &ToolBarWindow::textFontSizeChanged, this, [this](int size) {
         fontSize = size;
@@ -116,6 +220,62 @@ EditWindow::EditWindow(const QPixmap &screenshot, const QPoint &pos, QWidget *pa
     connect(toolBar, &ToolBarWindow::penColorChanged, this, [this](const QColor &color) {
         penColor = color;
     });
+    connect(toolBar, &ToolBarWindow::exportSizeChanged, this, [this](int maxWidth, qreal scale) {
+        exportMaxWidth = maxWidth;
+        exportScale = scale;
+    });
+    connect(toolBar, &ToolBarWindow::resampleFilterChanged, this, [this](int filter) {
+        resampleFilter = ImageResampler::Filter(filter);
+    });
+    connect(toolBar, &ToolBarWindow::slicesFromNotesRequested, this, [this]() {
+        // 每个序号笔记连同气泡框，四周留出一些上下文
+        const int margin = 40;
+        for (const Shape &shape : shapes) {
+            if (shape.type != NumberedNote) {
+                continue;
+            }
+            QRect rect = ShapeRenderer::bounds(shape).adjusted(-margin, -margin, margin, margin) & viewport;
+            if (!rect.isEmpty()) {
+                slices.append({QString("note%1").arg(shape.number), rect});
+            }
+        }
+        journal->setSlices(slices);
+        update();
+    });
+    connect(toolBar, &ToolBarWindow::clearSlicesRequested, this, [this]() {
+        slices.clear();
+        journal->setSlices(slices);
+        update();
+    });
+    connect(toolBar, &ToolBarWindow::exportSlicesRequested, this, [this]() {
+        exportSlices();
+    });
+    connect(toolBar, &ToolBarWindow::saveProjectRequested, this, [this]() {
+        saveProject();
+    });
+    connect(toolBar, &ToolBarWindow::compareRequested, this, [this]() {
+        compareWithEarlier();
+    });
+    connect(toolBar, &ToolBarWindow::findSimilarRequested, this, [this]() {
+        setMode(8);
+    });
+    connect(toolBar, &ToolBarWindow::maskSuggestionsRequested, this, [this]() {
+        for (int i = suggestions.size() - 1; i >= 0; --i) {
+            if (suggestions[i].intersects(viewport)) {
+                applySuggestion(i);
+            }
+        }
+    });
+    connect(toolBar, &ToolBarWindow::clearSuggestionsRequested, this, [this]() {
+        suggestions.clear();
+        update();
+    });
+    connect(toolBar, &ToolBarWindow::scrollCaptureRequested, this, [this]() {
+        startScrollCapture();
+    });
+    connect(toolBar, &ToolBarWindow::recordRequested, this, [this]() {
+        startRecording();
+    });
 
     show();
 }
@@ -123,43 +283,443 @@ EditWindow::EditWindow(const QPixmap &screenshot, const QPoint &pos, QWidget *pa
 
 EditWindow::~EditWindow()
 {
+    if (similarWatcher.isRunning()) {
+        QApplication::restoreOverrideCursor();
+    }
+    delete journal;
     delete toolBar;
     delete sizeDisplayWindow;
 }
 
-void EditWindow::updateScreenshot(const QPixmap &newScreenshot, const QPoint &newPos)
+void EditWindow::setViewport(const QRect &selection)
 {
-    screenshot = newScreenshot;
+    // 只移动视口，不裁剪截图；图层仅在尺寸变化时重新分配
+    bool resized = selection.size() != viewport.size();
+    QPoint delta = viewport.topLeft() - selection.topLeft();
+    viewport = selection;
+
+    if (resized) {
+        drawingLayer = drawingLayerPool.acquire(selection.size());
+        tempLayer = tempLayerPool.acquire(selection.size());
+        tempLayer.fill(Qt::transparent);
+        setFixedSize(selection.size());
 
-    QPixmap newDrawingLayer(newScreenshot.size());
-    newDrawingLayer.fill(Qt::transparent);
-    QPixmap newTempLayer(newScreenshot.size());
-    newTempLayer.fill(Qt::transparent);
+        QString sizeText = QString("%1x%2").arg(selection.width()).arg(selection.height());
+        sizeDisplayWindow->setSizeText(sizeText);
 
-    QPainter painter(&newDrawingLayer);
-    painter.drawPixmap(0, 0, drawingLayer);
+        // 统计自本次手柄拖拽开始以来图层缓冲的分配次数和字节数
+        qDebug() << "EditWindow: Resize gesture layer allocations:"
+                 << drawingLayerPool.stats().allocations + tempLayerPool.stats().allocations
+                 << ", bytes:" << drawingLayerPool.stats().bytes + tempLayerPool.stats().bytes;
+    }
 
-    drawingLayer = newDrawingLayer;
-    tempLayer = newTempLayer;
+    move(selection.topLeft());
+    if (resized) {
+        updateCanvas();
+    } else if (!delta.isNull()) {
+        // 尺寸不变时只平移已绘制的形状，新露出的边缘才重新绘制
+        scrollLayer(drawingLayer, delta);
+        drawShapes(QRegion(drawingLayer.rect()) - QRegion(drawingLayer.rect().translated(delta)));
+        sizeEstimator->update(viewport, shapes);
+    }
+    updateSizeDisplayPosition();
 
-    setFixedSize(newScreenshot.size());
-    move(newPos);
+    update();
+    qDebug() << "EditWindow: Viewport updated:" << viewport << ", resized:" << resized;
+}
+
+void EditWindow::setCapture(const QImage &image)
+{
+    // 形状坐标基于原始截图，替换时不需要换算
+    capture = QPixmap::fromImage(image);
+    preview = QPixmap();
+    drawingLayerPool.setLimit(capture.size());
+    tempLayerPool.setLimit(capture.size());
+    sizeEstimator->setCapture(image);
+    journal->setCapture(image);
+    analyzeSuggestions(image);
     updateCanvas();
+    update();
+    qDebug() << "EditWindow: Capture replaced:" << image.size();
+}
 
-    QString sizeText = QString("%1x%2").arg(newScreenshot.width()).arg(newScreenshot.height());
-    sizeDisplayWindow->setSizeText(sizeText);
-    updateSizeDisplayPosition();
+// 预览保持解码出的小尺寸，不放大成完整分辨率的缓冲，只在绘制时缩放
+void EditWindow::setPreview(const QImage &image, const QSize &fullSize)
+{
+    preview = QPixmap::fromImage(image);
+    previewFullSize = fullSize;
+    update();
+    qDebug() << "EditWindow: Showing preview" << image.size() << "for" << fullSize;
+}
+
+QPixmap EditWindow::getCanvas() const
+{
+    // 只在完成或导出时才真正生成选区像素
+    QPixmap canvas = capture.copy(viewport);
+    QPainter canvasPainter(&canvas);
+    canvasPainter.setRenderHint(QPainter::Antialiasing);
+    canvasPainter.drawImage(0, 0, drawingLayer);
+    return canvas;
+}
+
+void EditWindow::startExport(const ExportJob &job)
+{
+    if (exportPipeline->isRunning()) {
+        return;
+    }
+    // 先隐藏界面，合成、编码和交付都在后台完成
+    hide();
+    hideToolBar();
+    emit finished();
+    exportPipeline->start(job);
+    // 历史记录复用导出任务中已转换好的截图，压缩和写盘都在后台
+    CaptureHistory::add(projectData(job.capture));
+}
+
+void EditWindow::exportSlices()
+{
+    if (exportPipeline->isRunning()) {
+        return;
+    }
+    if (slices.isEmpty()) {
+        qDebug() << "EditWindow: No slices to export";
+        return;
+    }
+    QString defaultName = QDateTime::currentDateTime().toString("'screenshot_'yyyyMMdd_HHmmss'.png'");
+    QString filePath = QFileDialog::getSaveFileName(this, "导出全图和切片", QDir::home().filePath(defaultName), "PNG (*.png)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+    // 切片按原始分辨率导出，合成一次后并行编码所有文件
+    ExportJob job = createExportJob();
+    job.outputSize = QSize();
+    job.filePath = filePath;
+    job.slices = slices;
+    startExport(job);
+}
+
+void EditWindow::saveProject()
+{
+    QString defaultName = QDateTime::currentDateTime().toString("'screenshot_'yyyyMMdd_HHmmss'.sshot'");
+    const QString rawFilter = "截图项目 - 快速打开 (*.sshot)";
+    const QString compressedFilter = "截图项目 - 压缩 (*.sshot)";
+    QString selectedFilter = rawFilter;
+    QString filePath = QFileDialog::getSaveFileName(this, "保存为可编辑项目", QDir::home().filePath(defaultName),
+                                                    rawFilter + ";;" + compressedFilter, &selectedFilter);
+    if (filePath.isEmpty()) {
+        return;
+    }
+    if (!filePath.endsWith(".sshot", Qt::CaseInsensitive)) {
+        filePath += ".sshot";
+    }
+    // 项目保存后编辑器保持打开，可以继续编辑
+    ProjectFile::Compression compression = selectedFilter == compressedFilter ? ProjectFile::Qoi : ProjectFile::Raw;
+    if (!ProjectFile::save(filePath, projectData(capture.toImage()), compression)) {
+        qDebug() << "EditWindow: Failed to save project:" << filePath;
+    }
+}
+
+void EditWindow::startScrollCapture()
+{
+    if (exportPipeline->isRunning()) {
+        return;
+    }
+    // 选区在屏幕上的位置就是要反复抓取的区域，编辑器和遮罩都要先让开
+    QRect region(mapToGlobal(QPoint(0, 0)), size());
+    hide();
+    hideToolBar();
+    emit finished();
+    // 等窗口真正从屏幕上消失后再开始抓取
+    QTimer::singleShot(200, this, [this, region]() {
+        ScrollCaptureWindow *window = new ScrollCaptureWindow(region);
+        connect(window, &ScrollCaptureWindow::finished, this, [this](const QImage &image) {
+            if (image.isNull()) {
+                emit sessionEnded();
+                return;
+            }
+            // 长图不带标注，直接复制到剪贴板
+            ExportJob job;
+            job.capture = image;
+            job.viewport = image.rect();
+            exportPipeline->start(job);
+        });
+        connect(window, &ScrollCaptureWindow::canceled, this, &EditWindow::sessionEnded);
+    });
+}
+
+void EditWindow::startRecording()
+{
+    if (exportPipeline->isRunning()) {
+        return;
+    }
+    const QString apngFilter = "APNG - 真彩色动画 (*.png)";
+    const QString gifFilter = "GIF - 256 色动画 (*.gif)";
+    const bool apngSupported = AnimationWriter::isSupported(AnimationWriter::Apng);
+    QString selectedFilter = apngSupported ? apngFilter : gifFilter;
+    QString defaultName = QDateTime::currentDateTime().toString(apngSupported ? "'recording_'yyyyMMdd_HHmmss'.png'"
+                                                                               : "'recording_'yyyyMMdd_HHmmss'.gif'");
+    QString filePath = QFileDialog::getSaveFileName(this, "录制动画", QDir::home().filePath(defaultName),
+                                                    apngSupported ? apngFilter + ";;" + gifFilter : gifFilter,
+                                                    &selectedFilter);
+    if (filePath.isEmpty()) {
+        return;
+    }
+    AnimationWriter::Format format = AnimationWriter::Apng;
+    if (!apngSupported || selectedFilter == gifFilter || filePath.endsWith(".gif", Qt::CaseInsensitive)) {
+        format = AnimationWriter::Gif;
+        if (filePath.endsWith(".png", Qt::CaseInsensitive)) {
+            filePath.chop(4);
+            filePath += ".gif";
+        }
+    }
+
+    QRect region(mapToGlobal(QPoint(0, 0)), size());
+    hide();
+    hideToolBar();
+    emit finished();
+    QTimer::singleShot(200, this, [this, region, filePath, format]() {
+        RecordWindow *window = new RecordWindow(region, filePath, format);
+        connect(window, &RecordWindow::finished, this, &EditWindow::sessionEnded);
+    });
+}
+
+void EditWindow::compareWithEarlier()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, "选择之前的截图", QDir::homePath(),
+                                                    "截图 (*.png *.jpg *.jpeg *.bmp *.qoi *.sshot)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+    ProjectData earlier;
+    if (!(ProjectFile::isProject(filePath) && ProjectFile::load(filePath, earlier))) {
+        QFile file(filePath);
+        if (file.open(QIODevice::ReadOnly) && QoiReader::canRead(&file)) {
+            earlier.capture = QoiReader::read(&file);
+        } else {
+            earlier.capture = QImage(filePath);
+        }
+    }
+    if (earlier.capture.isNull()) {
+        qDebug() << "EditWindow: Failed to read earlier capture:" << filePath;
+        return;
+    }
 
+    // 比较原始截图而不是画布，已有的标注不会被当成变化。
+    // 之前的截图与完整截图同尺寸时比较同一区域，否则把它与当前选区左上角对齐
+    QImage current = capture.toImage();
+    QImage before = earlier.capture.size() == current.size() ? earlier.capture.copy(viewport) : earlier.capture;
+    const QList<QRect> regions = PixelDiff().changedRegions(before, current.copy(viewport));
+    for (const QRect &region : regions) {
+        Shape shape;
+        shape.type = Rectangle;
+        shape.rect = region.translated(viewport.topLeft()).adjusted(-2, -2, 2, 2) & viewport;
+        shape.width = shapeBorderWidth;
+        shape.color = Qt::red;
+        shapes.append(shape);
+        journal->addShape(shape);
+    }
+    updateCanvas();
     update();
-    qDebug() << "EditWindow: Screenshot updated, size:" << newScreenshot.size() << ", pos:" << newPos;
+    qDebug() << "EditWindow: Marked" << regions.size() << "changed regions against" << filePath;
+}
+
+void EditWindow::maskSimilar(const QRect &patch)
+{
+    // 在整幅截图中查找，选区之外的相同内容也会被遮盖，之后移动选区时不会漏出。
+    // 查找在后台线程进行，完成前忽略新的请求
+    if (similarWatcher.isRunning()) {
+        qDebug() << "EditWindow: Similar-patch search still running, request ignored";
+        return;
+    }
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    QImage image = capture.toImage();
+    similarWatcher.setFuture(QtConcurrent::run([image, patch]() {
+        return PatchFinder().findAll(image, patch);
+    }));
+}
+
+void EditWindow::applySimilarMasks()
+{
+    QApplication::restoreOverrideCursor();
+    const QList<QRect> matches = similarWatcher.result();
+    for (const QRect &match : matches) {
+        Shape shape = maskStroke(match);
+        shapes.append(shape);
+        journal->addShape(shape);
+    }
+    updateCanvas();
+    update();
+    qDebug() << "EditWindow: Masked" << matches.size() << "similar occurrences";
+}
+
+// 用遮罩画笔当前的颜色和粗细来回涂满矩形，和手动涂抹得到的遮罩一样，可以同样地拖动和撤销
+Shape EditWindow::maskStroke(const QRect &rect) const
+{
+    Shape shape;
+    shape.type = Mask;
+    shape.color = Qt::gray;
+    shape.width = mosaicSize;
+    // 圆头笔触向外扩展半个笔宽，路径收进半个笔宽才不会涂到矩形外面
+    const int half = mosaicSize / 2;
+    QRect path = rect.adjusted(half, half, -half, -half);
+    if (path.width() < 0) {
+        path.setLeft(rect.center().x());
+        path.setRight(rect.center().x());
+    }
+    if (path.height() < 0) {
+        path.setTop(rect.center().y());
+        path.setBottom(rect.center().y());
+    }
+    bool leftToRight = true;
+    for (int y = path.top();; y = qMin(y + qMax(1, mosaicSize - 1), path.bottom())) {
+        shape.points.append(QPoint(leftToRight ? path.left() : path.right(), y));
+        shape.points.append(QPoint(leftToRight ? path.right() : path.left(), y));
+        leftToRight = !leftToRight;
+        if (y == path.bottom()) {
+            break;
+        }
+    }
+    return shape;
+}
+
+void EditWindow::analyzeSuggestions(const QImage &image)
+{
+    if (image.isNull()) {
+        return;
+    }
+    suggestionWatcher.setFuture(QtConcurrent::run([image]() {
+        return TextRegionDetector::detect(image);
+    }));
+}
+
+QRect EditWindow::suggestionBadge(const QRect &suggestion) const
+{
+    // 角标放在建议区域与选区相交部分的左上角，区域一部分在选区外时也能点到
+    QRect visible = suggestion & viewport;
+    return QRect(visible.topLeft(), QSize(32, 16));
+}
+
+void EditWindow::applySuggestion(int index)
+{
+    Shape shape;
+    shape.type = Mask;
+    shape.rect = suggestions.takeAt(index);
+    shape.color = Qt::gray;
+    shape.width = mosaicSize;
+    shapes.append(shape);
+    journal->addShape(shape);
+    updateCanvas();
+    update();
+}
+
+ProjectData EditWindow::projectData(const QImage &captureImage) const
+{
+    ProjectData data;
+    data.capture = captureImage;
+    data.viewport = viewport;
+    data.shapes = shapes;
+    data.slices = slices;
+    data.noteNumber = noteNumber;
+    data.fontSize = fontSize;
+    data.textColor = textColor;
+    data.mosaicSize = mosaicSize;
+    data.shapeBorderWidth = shapeBorderWidth;
+    data.shapeBorderColor = shapeBorderColor;
+    data.penWidth = penWidth;
+    data.penColor = penColor;
+    return data;
+}
+
+void EditWindow::applyProject(const ProjectData &data)
+{
+    // 截图和视口由构造函数传入，这里只恢复形状和编辑器状态
+    selectedShape = nullptr;
+    shapes = data.shapes;
+    slices = data.slices;
+    noteNumber = data.noteNumber;
+    fontSize = data.fontSize;
+    textColor = data.textColor;
+    mosaicSize = data.mosaicSize;
+    shapeBorderWidth = data.shapeBorderWidth;
+    shapeBorderColor = data.shapeBorderColor;
+    penWidth = data.penWidth;
+    penColor = data.penColor;
+    journal->reset(data);
+    updateCanvas();
+    update();
+}
+
+QRect EditWindow::sliceRect(const QPoint &pos) const
+{
+    return QRect(startPoint, pos).normalized() & viewport;
+}
+
+ExportJob EditWindow::createExportJob() const
+{
+    ExportJob job;
+    job.capture = capture.toImage();
+    job.viewport = viewport;
+    job.shapes = shapes;
+
+    QSize size = viewport.size() * exportScale;
+    if (exportMaxWidth > 0 && size.width() > exportMaxWidth) {
+        size = QSize(exportMaxWidth, qMax(1, qRound(double(size.height()) * exportMaxWidth / size.width())));
+    }
+    if (size != viewport.size()) {
+        job.outputSize = size;
+        job.resampleFilter = resampleFilter;
+    }
+    return job;
 }
 
 void EditWindow::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
-    painter.drawPixmap(0, 0, canvas);
-    painter.drawPixmap(0, 0, tempLayer);
+    if (!preview.isNull() && !previewFullSize.isEmpty()) {
+        const qreal sx = qreal(preview.width()) / previewFullSize.width();
+        const qreal sy = qreal(preview.height()) / previewFullSize.height();
+        const QRectF source(viewport.x() * sx, viewport.y() * sy, viewport.width() * sx, viewport.height() * sy);
+        painter.drawPixmap(QRectF(rect()), preview, source);
+    } else {
+        painter.drawPixmap(rect(), capture, viewport);
+    }
+    painter.drawImage(0, 0, drawingLayer);
+    painter.drawImage(0, 0, tempLayer);
+
+    // 导出切片：绿色虚线框和名称
+    if (!slices.isEmpty()) {
+        painter.save();
+        painter.translate(-viewport.topLeft());
+        painter.setPen(QPen(QColor(0, 160, 80), 1, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.setFont(QFont("Arial", 9));
+        for (const ExportSlice &slice : slices) {
+            painter.drawRect(slice.rect.adjusted(0, 0, -1, -1));
+            painter.drawText(slice.rect.topLeft() + QPoint(4, 12), slice.name);
+        }
+        painter.restore();
+    }
+
+    // 打码建议：橙色虚线框，左上角的角标点击后遮盖
+    if (!suggestions.isEmpty()) {
+        painter.save();
+        painter.translate(-viewport.topLeft());
+        painter.setFont(QFont("Arial", 9));
+        for (const QRect &suggestion : std::as_const(suggestions)) {
+            if (!suggestion.intersects(viewport)) {
+                continue;
+            }
+            painter.setPen(QPen(QColor(255, 140, 0), 1, Qt::DashLine));
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(suggestion.adjusted(0, 0, -1, -1));
+            QRect badge = suggestionBadge(suggestion);
+            painter.fillRect(badge, QColor(255, 140, 0));
+            painter.setPen(Qt::white);
+            painter.drawText(badge, Qt::AlignCenter, "遮盖");
+        }
+        painter.restore();
+    }
 
     // 绘制虚线海蓝色边框
     QPen borderPen(QColor(0, 105, 148), borderWidth, Qt::DashLine); // 海蓝色虚线边框
@@ -190,8 +750,16 @@ void EditWindow::mousePressEvent(QMouseEvent *event)
         QPoint pos = event->pos();
         MainWindow *mainWindow = qobject_cast<MainWindow*>(parent());
 
+        // 点击打码建议的角标时只遮盖该区域
+        for (int i = 0; i < suggestions.size(); ++i) {
+            if (suggestions[i].intersects(viewport) && suggestionBadge(suggestions[i]).contains(toCapture(pos))) {
+                applySuggestion(i);
+                return;
+            }
+        }
+
         // 检测并启动形状拖拽
-        startShapeDragging(pos);
+        startShapeDragging(toCapture(pos));
 
         // 如果没有选中形状，且处于无模式（mode == -1）
         if (!selectedShape && mode == -1) {
@@ -203,8 +771,8 @@ void EditWindow::mousePressEvent(QMouseEvent *event)
 
         // 如果没有调整手柄或拖拽，则开始绘制新形状
         if (mode >= 0 && !isAdjustingHandle && !isDragging && !isDraggingSelection &&
-            activeHandle == None && mainWindow && !mainWindow->isAdjustingSelectionState()) {
-            startDrawingShape(pos);
+            activeHandle == None && !(mainWindow && mainWindow->isAdjustingSelectionState())) {
+            startDrawingShape(toCapture(pos));
         }
     }
 }
@@ -214,7 +782,7 @@ void EditWindow::mouseMoveEvent(QMouseEvent *event)
 {
     QPoint pos = event->pos();
 
-    if ((mode == 0 || mode == 1) && isDrawing && (event->buttons() & Qt::LeftButton)) {
+    if ((mode == 0 || mode == 1 || mode == 7 || mode == 8) && isDrawing && (event->buttons() & Qt::LeftButton)) {
         pos.setX(qBound(borderWidth, pos.x(), width() - borderWidth));
         pos.setY(qBound(borderWidth, pos.y(), height() - borderWidth));
     }
@@ -224,12 +792,13 @@ void EditWindow::mouseMoveEvent(QMouseEvent *event)
     } else if (activeHandle != None && (event->buttons() & Qt::LeftButton)) {
         emit handleDragged(activeHandle, event->globalPosition().toPoint());
     } else if (isDragging && (event->buttons() & Qt::LeftButton) && selectedShape) {
-        handleShapeDragging(pos);
+        handleShapeDragging(toCapture(pos));
     } else if (mode >= 0 && (event->buttons() & Qt::LeftButton) && isDrawing) {
+        tempLayer.fill(Qt::transparent);
         QPainter painter(&tempLayer);
         painter.setRenderHint(QPainter::Antialiasing);
-        tempLayer.fill(Qt::transparent);
-        drawTemporaryPreview(pos, painter);
+        painter.translate(-viewport.topLeft());
+        drawTemporaryPreview(toCapture(pos), painter);
     } else {
         updateCursorStyle(pos);
     }
@@ -252,15 +821,15 @@ void EditWindow::mouseReleaseEvent(QMouseEvent *event)
             stopHandleAdjustment();
         } else if (isDragging) {
             stopShapeDragging();
-        } else if (mode == 0 || mode == 1 || mode == 3 || mode == 4 || mode == 6) {
-            finishDrawingShape(pos);
+        } else if (mode == 0 || mode == 1 || mode == 3 || mode == 4 || mode == 6 || mode == 7 || mode == 8) {
+            finishDrawingShape(toCapture(pos));
         }
     }
 }
 void EditWindow::mouseDoubleClickEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
-        QPoint pos = event->pos();
+        QPoint pos = toCapture(event->pos());
         Shape *shape = hitTest(pos);
         if (shape && (shape->type == Text || shape->type == NumberedNote)) {
             QString currentText = shape->type == Text ? shape->text : shape->text.mid(shape->text.indexOf(". ") + 2);
@@ -273,7 +842,7 @@ void EditWindow::mouseDoubleClickEvent(QMouseEvent *event)
                     shape->text = newText;
                     QFont font("Arial", shape->width);
                     QFontMetrics fm(font);
-                    QRect textRect = fm.boundingRect(QRect(0, 0, width() - shape->rect.x(), height() - shape->rect.y()),
+                    QRect textRect = fm.boundingRect(QRect(0, 0, viewport.right() + 1 - shape->rect.x(), viewport.bottom() + 1 - shape->rect.y()),
                                                      Qt::AlignLeft | Qt::TextWordWrap, newText);
                     shape->rect.setSize(textRect.size());
                 } else if (shape->type == NumberedNote) {
@@ -287,6 +856,7 @@ void EditWindow::mouseDoubleClickEvent(QMouseEvent *event)
                     int bubbleY = shape->rect.y() - (textHeight - 32) / 2;
                     shape->bubbleRect = QRect(bubbleX, bubbleY, textWidth, textHeight);
                 }
+                journal->updateShape(int(shape - shapes.constData()), *shape);
                 updateCanvas();
                 update();
             }
@@ -311,83 +881,23 @@ QRect EditWindow::getHandleRect(Handle handle) const
     }
 }
 
-void EditWindow::drawShape(QPainter &painter, const Shape &shape)
+void EditWindow::updateCanvas()
 {
-    painter.setPen(QPen(shape.color, shape.width));
-    painter.setBrush(Qt::NoBrush);
-    if (shape.type == Rectangle) {
-        painter.drawRect(shape.rect);
-    } else if (shape.type == Ellipse) {
-        painter.drawEllipse(shape.rect);
-    } else if (shape.type == Text) {
-        painter.setFont(QFont("Arial", shape.width));
-        painter.setPen(shape.color);
-        painter.drawText(shape.rect, Qt::AlignLeft | Qt::TextWordWrap, shape.text);
-    } else if (shape.type == NumberedNote) {
-        int fixedFontSize = 16;
-        painter.setFont(QFont("Arial", fixedFontSize));
-        int boxSize = 32;
-        QPoint topLeft = shape.rect.topLeft();
-        painter.setBrush(Qt::red);
-        painter.setPen(Qt::NoPen);
-        QPoint center = topLeft + QPoint(boxSize / 2, boxSize / 2);
-        painter.drawEllipse(center, boxSize / 2, boxSize / 2);
-        QFontMetrics fmSeq(QFont("Arial", fixedFontSize));
-        QString numberText = QString::number(shape.number);
-        int numberWidth = fmSeq.horizontalAdvance(numberText);
-        int textHeight = fmSeq.height();
-        painter.setPen(Qt::white);
-        int verticalOffset = textHeight / 4;
-        QPoint textPos = center - QPoint(numberWidth / 2, -verticalOffset);
-        painter.drawText(textPos, numberText);
-
-        if (!shape.bubbleRect.isNull()) {
-            painter.setBrush(shape.bubbleColor);
-            painter.setPen(QPen(shape.bubbleBorderColor, 1));
-            QPainterPath path;
-            int radius = 5;
-            path.addRoundedRect(shape.bubbleRect, radius, radius);
-            painter.drawPath(path);
-
-            painter.setFont(QFont("Arial", shape.width));
-            painter.setPen(shape.color);
-            QString contentText = shape.text.mid(shape.text.indexOf(". ") + 2);
-            painter.drawText(shape.bubbleRect, Qt::AlignCenter | Qt::TextWordWrap, contentText);
-        }
-    } else if (shape.type == Pen || shape.type == Mask) {
-        painter.setPen(QPen(shape.color, shape.width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        painter.setBrush(Qt::NoBrush);
-        for (int i = 1; i < shape.points.size(); ++i) {
-            painter.drawLine(shape.points[i - 1], shape.points[i]);
-        }
-    } else if (shape.type == Arrow) {
-        painter.setPen(QPen(shape.color, shape.width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
-        if (shape.points.size() == 2) {
-            QPoint start = shape.points[0];
-            QPoint end = shape.points[1];
-            painter.drawLine(start, end);
-            double angle = atan2(end.y() - start.y(), end.x() - start.x());
-            int arrowSize = shape.width * 3;
-            QPointF arrowP1 = end - QPointF(cos(angle + M_PI / 6) * arrowSize, sin(angle + M_PI / 6) * arrowSize);
-            QPointF arrowP2 = end - QPointF(cos(angle - M_PI / 6) * arrowSize, sin(angle - M_PI / 6) * arrowSize);
-            painter.drawLine(end, arrowP1);
-            painter.drawLine(end, arrowP2);
-        }
-    }
+    drawingLayer.fill(Qt::transparent);
+    drawShapes(QRegion(drawingLayer.rect()));
+    sizeEstimator->update(viewport, shapes);
 }
 
-void EditWindow::updateCanvas()
+void EditWindow::drawShapes(const QRegion &area)
 {
-    drawingLayer.fill(Qt::transparent);
+    if (area.isEmpty() || shapes.isEmpty()) {
+        return;
+    }
     QPainter painter(&drawingLayer);
     painter.setRenderHint(QPainter::Antialiasing);
-    for (const Shape &shape : shapes) {
-        drawShape(painter, shape);
-    }
-    canvas = screenshot.copy();
-    QPainter canvasPainter(&canvas);
-    canvasPainter.setRenderHint(QPainter::Antialiasing);
-    canvasPainter.drawPixmap(0, 0, drawingLayer);
+    painter.setClipRegion(area);
+    painter.translate(-viewport.topLeft()); // 形状坐标基于原始截图
+    ShapeRenderer::drawAll(painter, shapes);
 }
 
 Shape* EditWindow::hitTest(const QPoint &pos)
@@ -566,6 +1076,8 @@ void EditWindow::startHandleAdjustment(const QPoint &pos, QMouseEvent *event)
             isAdjustingFromEditMode = true;
             dragStartPos = event->globalPosition().toPoint();
             toolBar->hide();
+            drawingLayerPool.resetStats();
+            tempLayerPool.resetStats();
             qDebug() << "EditWindow: Handle pressed:" << activeHandle << "at:" << pos;
             emit handleDragged(activeHandle, dragStartPos);
             hitHandle = true;
@@ -598,12 +1110,13 @@ void EditWindow::startDrawingShape(const QPoint &pos)
             Shape shape;
             shape.type = Text;
             QFont font("Arial", fontSize);
-            QRect textRect = QFontMetrics(font).boundingRect(QRect(0, 0, width() - pos.x(), height() - pos.y()), Qt::AlignLeft | Qt::TextWordWrap, text);
+            QRect textRect = QFontMetrics(font).boundingRect(QRect(0, 0, viewport.right() + 1 - pos.x(), viewport.bottom() + 1 - pos.y()), Qt::AlignLeft | Qt::TextWordWrap, text);
             shape.rect = QRect(pos, textRect.size());
             shape.text = text;
             shape.color = textColor;
             shape.width = fontSize;
             shapes.append(shape);
+            journal->addShape(shape);
             updateCanvas();
             update();
             isDrawing = false;
@@ -633,6 +1146,8 @@ void EditWindow::startDrawingShape(const QPoint &pos)
 
             shapes.append(shape);
             noteNumber++;
+            journal->addShape(shape);
+            journal->setNoteNumber(noteNumber);
             updateCanvas();
             update();
             isDrawing = false;
@@ -671,10 +1186,14 @@ void EditWindow::handleWindowDragging(QMouseEvent *event)
 
     MainWindow *mainWindow = qobject_cast<MainWindow*>(parent());
     if (mainWindow) {
-        QSize originalSize = size();
-        QPixmap newScreenshot = mainWindow->updateSelectionPosition(newPos);
-        updateScreenshot(newScreenshot, newPos);
-        setFixedSize(originalSize);
+        setViewport(mainWindow->updateSelectionPosition(newPos));
+    } else {
+        // 独立打开的项目没有主窗口，选区直接在截图范围内移动
+        QRect selection(newPos, viewport.size());
+        const QSize bounds = preview.isNull() ? capture.size() : previewFullSize;
+        selection.moveLeft(qBound(0, selection.left(), bounds.width() - selection.width()));
+        selection.moveTop(qBound(0, selection.top(), bounds.height() - selection.height()));
+        setViewport(selection);
     }
 
     dragStartPos = event->globalPosition().toPoint();
@@ -695,10 +1214,10 @@ void EditWindow::handleShapeDragging(const QPoint &pos)
             QPoint oldEnd = selectedShape->points[1];
             selectedShape->points[0] = oldStart + offset;
             selectedShape->points[1] = oldEnd + offset;
-            selectedShape->points[0].setX(qBound(0, selectedShape->points[0].x(), width()));
-            selectedShape->points[0].setY(qBound(0, selectedShape->points[0].y(), height()));
-            selectedShape->points[1].setX(qBound(0, selectedShape->points[1].x(), width()));
-            selectedShape->points[1].setY(qBound(0, selectedShape->points[1].y(), height()));
+            selectedShape->points[0].setX(qBound(viewport.left(), selectedShape->points[0].x(), viewport.right() + 1));
+            selectedShape->points[0].setY(qBound(viewport.top(), selectedShape->points[0].y(), viewport.bottom() + 1));
+            selectedShape->points[1].setX(qBound(viewport.left(), selectedShape->points[1].x(), viewport.right() + 1));
+            selectedShape->points[1].setY(qBound(viewport.top(), selectedShape->points[1].y(), viewport.bottom() + 1));
         }
         drawingLayer.fill(Qt::transparent);
         updateCanvas();
@@ -714,8 +1233,8 @@ void EditWindow::handleShapeDragging(const QPoint &pos)
         int combinedHeight = combinedRect.height();
 
         QPoint newRectTopLeft = selectedShape->rect.topLeft() + offset;
-        newRectTopLeft.setX(qBound(borderWidth, newRectTopLeft.x(), width() - combinedWidth - borderWidth - 1));
-        newRectTopLeft.setY(qBound(borderWidth, newRectTopLeft.y(), height() - combinedHeight - borderWidth - 1));
+        newRectTopLeft.setX(qBound(viewport.left() + borderWidth, newRectTopLeft.x(), viewport.right() - combinedWidth - borderWidth));
+        newRectTopLeft.setY(qBound(viewport.top() + borderWidth, newRectTopLeft.y(), viewport.bottom() - combinedHeight - borderWidth));
 
         selectedShape->rect.moveTo(newRectTopLeft);
         selectedShape->bubbleRect.moveTo(newRectTopLeft + bubbleOffset);
@@ -728,8 +1247,8 @@ void EditWindow::handleShapeDragging(const QPoint &pos)
         int rectWidth = selectedShape->rect.width();
         int rectHeight = selectedShape->rect.height();
         QPoint newRectTopLeft = selectedShape->rect.topLeft() + offset;
-        newRectTopLeft.setX(qBound(borderWidth, newRectTopLeft.x(), width() - rectWidth - borderWidth - 1));
-        newRectTopLeft.setY(qBound(borderWidth, newRectTopLeft.y(), height() - rectHeight - borderWidth - 1));
+        newRectTopLeft.setX(qBound(viewport.left() + borderWidth, newRectTopLeft.x(), viewport.right() - rectWidth - borderWidth));
+        newRectTopLeft.setY(qBound(viewport.top() + borderWidth, newRectTopLeft.y(), viewport.bottom() - rectHeight - borderWidth));
         selectedShape->rect.moveTo(newRectTopLeft);
         updateCanvas();
         update();
@@ -740,8 +1259,8 @@ void EditWindow::handleShapeDragging(const QPoint &pos)
         int borderAdjustment = (selectedShape->type == Rectangle || selectedShape->type == Ellipse) ? shapeBorderWidth : 0;
         int halfBorder = borderAdjustment / 2;
         QPoint newRectTopLeft = selectedShape->rect.topLeft() + offset;
-        newRectTopLeft.setX(qBound(halfBorder, newRectTopLeft.x(), width() - rectWidth - halfBorder));
-        newRectTopLeft.setY(qBound(halfBorder, newRectTopLeft.y(), height() - rectHeight - halfBorder));
+        newRectTopLeft.setX(qBound(viewport.left() + halfBorder, newRectTopLeft.x(), viewport.right() + 1 - rectWidth - halfBorder));
+        newRectTopLeft.setY(qBound(viewport.top() + halfBorder, newRectTopLeft.y(), viewport.bottom() + 1 - rectHeight - halfBorder));
         selectedShape->rect.moveTo(newRectTopLeft);
         updateCanvas();
         update();
@@ -752,20 +1271,25 @@ void EditWindow::handleShapeDragging(const QPoint &pos)
 
 void EditWindow::drawTemporaryPreview(const QPoint &pos, QPainter &painter)
 {
-    if (mode == 0 || mode == 1) {
+    if (mode == 7 || mode == 8) {
+        painter.setPen(QPen(mode == 7 ? QColor(0, 160, 80) : Qt::red, 1, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(sliceRect(pos).adjusted(0, 0, -1, -1));
+        update();
+    } else if (mode == 0 || mode == 1) {
         QPoint endPoint = pos;
-        endPoint.setX(qBound(borderWidth, endPoint.x(), width() - borderWidth));
-        endPoint.setY(qBound(borderWidth, endPoint.y(), height() - borderWidth));
+        endPoint.setX(qBound(viewport.left() + borderWidth, endPoint.x(), viewport.right() + 1 - borderWidth));
+        endPoint.setY(qBound(viewport.top() + borderWidth, endPoint.y(), viewport.bottom() + 1 - borderWidth));
 
         int left = qMin(startPoint.x(), endPoint.x());
         int top = qMin(startPoint.y(), endPoint.y());
         int right = qMax(startPoint.x(), endPoint.x());
         int bottom = qMax(startPoint.y(), endPoint.y());
 
-        left = qMax(borderWidth, left);
-        top = qMax(borderWidth, top);
-        right = qMin(right, width() - borderWidth - 1);
-        bottom = qMin(bottom, height() - borderWidth - 1);
+        left = qMax(viewport.left() + borderWidth, left);
+        top = qMax(viewport.top() + borderWidth, top);
+        right = qMin(right, viewport.right() - borderWidth);
+        bottom = qMin(bottom, viewport.bottom() - borderWidth);
 
         currentRect.setCoords(left, top, right, bottom);
 
@@ -786,12 +1310,12 @@ void EditWindow::drawTemporaryPreview(const QPoint &pos, QPainter &painter)
                 } else {
                     currentRect.setBottom(currentRect.top() + size);
                 }
-                if (currentRect.right() > width() - borderWidth - 1) {
-                    currentRect.setRight(width() - borderWidth - 1);
+                if (currentRect.right() > viewport.right() - borderWidth) {
+                    currentRect.setRight(viewport.right() - borderWidth);
                     currentRect.setLeft(currentRect.right() - size);
                 }
-                if (currentRect.bottom() > height() - borderWidth - 1) {
-                    currentRect.setBottom(height() - borderWidth - 1);
+                if (currentRect.bottom() > viewport.bottom() - borderWidth) {
+                    currentRect.setBottom(viewport.bottom() - borderWidth);
                     currentRect.setTop(currentRect.bottom() - size);
                 }
             }
@@ -846,10 +1370,9 @@ void EditWindow::drawTemporaryPreview(const QPoint &pos, QPainter &painter)
                     QPoint start = currentShape->points[0];
                     QPoint end = currentShape->points[1];
                     painter.drawLine(start, end);
-                    double angle = atan2(end.y() - start.y(), end.x() - start.x());
-                    int arrowSize = currentShape->width * 3;
-                    QPointF arrowP1 = end - QPointF(cos(angle + M_PI / 6) * arrowSize, sin(angle + M_PI / 6) * arrowSize);
-                    QPointF arrowP2 = end - QPointF(cos(angle - M_PI / 6) * arrowSize, sin(angle - M_PI / 6) * arrowSize);
+                    // 与导出共用同一份箭头几何，预览和结果不会不一致
+                    QPointF arrowP1, arrowP2;
+                    ShapeRenderer::arrowHead(*currentShape, arrowP1, arrowP2);
                     painter.drawLine(end, arrowP1);
                     painter.drawLine(end, arrowP2);
                 }
@@ -865,13 +1388,14 @@ void EditWindow::drawTemporaryPreview(const QPoint &pos, QPainter &painter)
 void EditWindow::updateCursorStyle(const QPoint &pos)
 {
     QCursor cursor;
-    Shape *hoveredShape = hitTest(pos);
+    QPoint capturePos = toCapture(pos);
+    Shape *hoveredShape = hitTest(capturePos);
     int hitBorderWidth = 10;
     if (hoveredShape) {
         if (hoveredShape->type == Arrow && hoveredShape->points.size() == 2) {
             QRect startRect(hoveredShape->points[0] - QPoint(hitBorderWidth, hitBorderWidth), QSize(hitBorderWidth * 2, hitBorderWidth * 2));
             QRect endRect(hoveredShape->points[1] - QPoint(hitBorderWidth, hitBorderWidth), QSize(hitBorderWidth * 2, hitBorderWidth * 2));
-            if (startRect.contains(pos) || endRect.contains(pos)) {
+            if (startRect.contains(capturePos) || endRect.contains(capturePos)) {
                 cursor = Qt::CrossCursor;
             } else {
                 cursor = Qt::SizeAllCursor;
@@ -929,9 +1453,16 @@ void EditWindow::updateCursorStyle(const QPoint &pos)
 }
 
 
+// 拖动和调整选区时每次移动都会调用 setViewport，日志只记录手势结束时的视口
+void EditWindow::commitViewport()
+{
+    journal->setViewport(viewport);
+}
+
 void EditWindow::stopWindowDragging()
 {
     isDraggingSelection = false;
+    commitViewport();
     toolBar->show();
     toolBar->adjustPosition();
     qDebug() << "EditWindow: Stop dragging selection, toolbar shown and repositioned";
@@ -956,6 +1487,9 @@ void EditWindow::stopHandleAdjustment()
 
 void EditWindow::stopShapeDragging()
 {
+    if (selectedShape) {
+        journal->updateShape(int(selectedShape - shapes.constData()), *selectedShape);
+    }
     isDragging = false;
     selectedShape = nullptr;
     updateCanvas();
@@ -975,10 +1509,10 @@ void EditWindow::finishDrawingShape(const QPoint &pos)
             int right = qMax(startPoint.x(), pos.x());
             int bottom = qMax(startPoint.y(), pos.y());
 
-            left = qMax(borderWidth, left);
-            top = qMax(borderWidth, top);
-            right = qMin(right, width() - borderWidth - 1);
-            bottom = qMin(bottom, height() - borderWidth - 1);
+            left = qMax(viewport.left() + borderWidth, left);
+            top = qMax(viewport.top() + borderWidth, top);
+            right = qMin(right, viewport.right() - borderWidth);
+            bottom = qMin(bottom, viewport.bottom() - borderWidth);
 
             shape.rect.setCoords(left, top, right, bottom);
 
@@ -994,12 +1528,12 @@ void EditWindow::finishDrawingShape(const QPoint &pos)
                 } else {
                     shape.rect.setBottom(shape.rect.top() + size);
                 }
-                if (shape.rect.right() > width() - borderWidth - 1) {
-                    shape.rect.setRight(width() - borderWidth - 1);
+                if (shape.rect.right() > viewport.right() - borderWidth) {
+                    shape.rect.setRight(viewport.right() - borderWidth);
                     shape.rect.setLeft(shape.rect.right() - size);
                 }
-                if (shape.rect.bottom() > height() - borderWidth - 1) {
-                    shape.rect.setBottom(height() - borderWidth - 1);
+                if (shape.rect.bottom() > viewport.bottom() - borderWidth) {
+                    shape.rect.setBottom(viewport.bottom() - borderWidth);
                     shape.rect.setTop(shape.rect.bottom() - size);
                 }
             }
@@ -1007,16 +1541,44 @@ void EditWindow::finishDrawingShape(const QPoint &pos)
             shape.width = shapeBorderWidth;
             shape.color = shapeBorderColor;
             shapes.append(shape);
+            journal->addShape(shape);
         }
         tempLayer.fill(Qt::transparent);
         updateCanvas();
         update();
         isDrawing = false;
     } else if (mode == 3 || mode == 4 || mode == 6) {
+        // 画笔、遮罩和箭头在按下时就已加入列表，松开时才记录完整的形状
+        if (isDrawing && !shapes.isEmpty()) {
+            journal->addShape(shapes.last());
+        }
         tempLayer.fill(Qt::transparent);
         updateCanvas();
         update();
         isDrawing = false;
         qDebug() << "EditWindow: Mode 3/4/6 completed, mode:" << mode << ", isDrawing:" << isDrawing;
+    } else if (mode == 8 && isDrawing) {
+        tempLayer.fill(Qt::transparent);
+        isDrawing = false;
+        QRect rect = sliceRect(pos);
+        if (rect.width() >= 4 && rect.height() >= 4) {
+            maskSimilar(rect);
+        }
+        update();
+    } else if (mode == 7 && isDrawing) {
+        tempLayer.fill(Qt::transparent);
+        isDrawing = false;
+        QRect rect = sliceRect(pos);
+        if (rect.width() >= 4 && rect.height() >= 4) {
+            bool ok = false;
+            QString name = QInputDialog::getText(this, "切片名称", "请输入切片名称:", QLineEdit::Normal,
+                                                 QString("slice%1").arg(slices.size() + 1), &ok);
+            if (ok && !name.trimmed().isEmpty()) {
+                slices.append({name.trimmed(), rect});
+                journal->setSlices(slices);
+                qDebug() << "EditWindow: Slice added:" << name << rect;
+            }
+        }
+        update();
     }
 }
@@ -5,24 +5,37 @@
 #include <QPixmap>
 #include <QMouseEvent>
 #include <QList>
+#include <QFutureWatcher>
 #include "common.h"
 #include "shape.h"
+#include "layerbufferpool.h"
+#include "exportpipeline.h"
+#include "projectfile.h"
 
 class ToolBarWindow;
 class SizeDisplayWindow;
+class SizeEstimator;
+class SessionJournal;
 
 class EditWindow : public QWidget {
     Q_OBJECT
 
 public:
-    EditWindow(const QPixmap &screenshot, const QPoint &pos, QWidget *parent = nullptr);
+    EditWindow(const QPixmap &capture, const QRect &selection, QWidget *parent = nullptr);
     ~EditWindow();
-    void updateScreenshot(const QPixmap &newScreenshot, const QPoint &newPos);
-    QPixmap getCanvas() const { return canvas; }
+    void setViewport(const QRect &selection);
+    void commitViewport(); // 选区拖动或调整结束时把视口写进崩溃恢复日志
+    void setCapture(const QImage &image);
+    // 完整图像解码前先显示的缩小预览，fullSize 是完整图像的尺寸
+    void setPreview(const QImage &image, const QSize &fullSize);
+    QPixmap getCanvas() const;
+    ExportJob createExportJob() const;
     void setMode(int newMode);
     void hideToolBar();
     bool getIsAdjustingFromEditMode() const { return isAdjustingFromEditMode; }
     void showToolBar();
+    ProjectData projectData(const QImage &captureImage) const;
+    void applyProject(const ProjectData &data);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
@@ -37,13 +50,18 @@ protected:
 signals:
     void handleDragged(Handle handle, const QPoint &globalPos);
     void handleReleased();
-    void finished(const QPixmap &pixmap);
+    void finished();
+    void sessionEnded(); // 导出完成、失败或取消，编辑器可以销毁
 
 private:
-    QPixmap screenshot;
-    QPixmap canvas;
-    QPixmap drawingLayer;
-    QPixmap tempLayer;
+    QPixmap capture;  // 完整的原始截图，选区只是它上面的一个视口
+    QPixmap preview;  // 非空时代替 capture 显示，绘制时按比例放大到截图坐标
+    QSize previewFullSize;
+    QRect viewport;   // 当前选区在原始截图中的位置，形状坐标都基于原始截图
+    LayerBufferPool drawingLayerPool;
+    LayerBufferPool tempLayerPool;
+    QImage drawingLayer;  // 视图由 drawingLayerPool 提供，选区缩放时复用同一块缓冲
+    QImage tempLayer;
     int borderWidth = 3;
     QColor borderColor = Qt::blue;
     Qt::PenStyle borderStyle = Qt::DashLine;
@@ -56,8 +74,12 @@ private:
     bool isAdjustingHandle = false;
     bool isDrawing = false;
     bool isAdjustingFromEditMode = false;
-    int mode = -1; // -1:无, 0:矩形, 1:圆形, 2:文本, 3:画笔, 4:遮罩, 5:序号笔记, 6:箭头
+    int mode = -1; // -1:无, 0:矩形, 1:圆形, 2:文本, 3:画笔, 4:遮罩, 5:序号笔记, 6:箭头, 7:切片, 8:遮盖相同内容
     QList<Shape> shapes;
+    QList<ExportSlice> slices; // 命名的导出区域，只在编辑器中显示，不会画进导出图像
+    QList<QRect> suggestions;  // 后台分析出的疑似文字区域，点击角标即可遮盖
+    QFutureWatcher<QList<QRect>> suggestionWatcher;
+    QFutureWatcher<QList<QRect>> similarWatcher; // 后台查找与选中区域相同的内容
     Shape *selectedShape = nullptr;
     QPoint startPoint;
     int fontSize = 16;
@@ -71,15 +93,35 @@ private:
     QRect currentRect;
     int noteNumber = 1; // 跟踪序号，初始为 1
     SizeDisplayWindow *sizeDisplayWindow;
+    SizeEstimator *sizeEstimator;
+    SessionJournal *journal; // 崩溃恢复日志，记录每次完成的编辑
+    ExportPipeline *exportPipeline;
+    int exportMaxWidth = 0;    // 导出时的最大宽度，0 表示不限制
+    qreal exportScale = 1.0;   // 导出时的缩放倍数
+    ImageResampler::Filter resampleFilter = ImageResampler::Lanczos3;
 
     QRect getHandleRect(Handle handle) const;
-    void drawShape(QPainter &painter, const Shape &shape);
     void updateCanvas();
+    void drawShapes(const QRegion &area); // area 为图层坐标，只在其中绘制形状
     Shape* hitTest(const QPoint &pos);
     bool isOnBorder(const QRect &rect, const QPoint &pos, int borderWidth = 5);
     bool isOnEllipseBorder(const QRect &rect, const QPoint &pos, int borderWidth);
     int calculateHandleSize() const;
     void updateSizeDisplayPosition();
+    void startExport(const ExportJob &job);
+    QPoint toCapture(const QPoint &pos) const { return pos + viewport.topLeft(); }
+    QRect sliceRect(const QPoint &pos) const;
+    void exportSlices();
+    void saveProject();
+    void compareWithEarlier();
+    void startScrollCapture();
+    void startRecording();
+    void maskSimilar(const QRect &patch);
+    void applySimilarMasks();
+    Shape maskStroke(const QRect &rect) const;
+    void analyzeSuggestions(const QImage &image);
+    QRect suggestionBadge(const QRect &suggestion) const;
+    void applySuggestion(int index);
 
     // 新增的私有函数
     void startShapeDragging(const QPoint &pos);
@@ -0,0 +1,120 @@
+#include "exportbenchmark.h"
+#include "pngencoder.h"
+#include "qoicodec.h"
+#include "colorquantizer.h"
+#include "imageresampler.h"
+#include <QBuffer>
+#include <QImageWriter>
+#include <QImageReader>
+#include <QElapsedTimer>
+#include <QDebug>
+
+static void report(const QString &name, const QImage &image, qint64 encodeNsecs, qint64 decodeNsecs, qint64 bytes)
+{
+    double encodeMs = encodeNsecs / 1e6;
+    double decodeMs = decodeNsecs / 1e6;
+    double megapixels = double(image.width()) * image.height() / 1e6;
+    qDebug().noquote() << QString("ExportBenchmark: %1 %2x%3 encode %4 ms (%5 MP/s), decode %6 ms, %7 bytes")
+                              .arg(name)
+                              .arg(image.width())
+                              .arg(image.height())
+                              .arg(encodeMs, 0, 'f', 1)
+                              .arg(encodeMs > 0 ? megapixels / (encodeMs / 1000.0) : 0.0, 0, 'f', 1)
+                              .arg(decodeMs, 0, 'f', 1)
+                              .arg(bytes);
+}
+
+static qint64 timePngDecode(const QByteArray &data)
+{
+    QElapsedTimer timer;
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    timer.start();
+    QImageReader reader(&buffer, "png");
+    reader.read();
+    return timer.nsecsElapsed();
+}
+
+bool ExportBenchmark::isEnabled()
+{
+    return qEnvironmentVariableIsSet("SCREENSHOT_BENCHMARK");
+}
+
+void ExportBenchmark::compareEncoders(const QImage &image)
+{
+    QElapsedTimer timer;
+
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        timer.start();
+        QImageWriter writer(&buffer, "png");
+        writer.write(image);
+        qint64 encodeNsecs = timer.nsecsElapsed();
+        report("QImageWriter png", image, encodeNsecs, timePngDecode(data), data.size());
+    }
+
+    const PngEncoder::Preset presets[] = {PngEncoder::Fastest, PngEncoder::Balanced, PngEncoder::Smallest};
+    for (PngEncoder::Preset preset : presets) {
+        timer.start();
+        QByteArray data = PngEncoder(preset).encode(image);
+        qint64 encodeNsecs = timer.nsecsElapsed();
+        report("PngEncoder " + PngEncoder::presetName(preset), image, encodeNsecs, timePngDecode(data), data.size());
+    }
+
+    // 量化耗时计入编码时间；误差过大放弃量化时不输出这一行
+    const bool ditherModes[] = {false, true};
+    for (bool dither : ditherModes) {
+        timer.start();
+        QImage indexed = ColorQuantizer(256, dither).quantize(image);
+        if (indexed.isNull()) {
+            break;
+        }
+        QByteArray data = PngEncoder(PngEncoder::Balanced).encode(indexed);
+        qint64 encodeNsecs = timer.nsecsElapsed();
+        report(dither ? "PngEncoder palette+dither" : "PngEncoder palette", image, encodeNsecs, timePngDecode(data), data.size());
+    }
+
+    {
+        QByteArray data;
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        timer.start();
+        QoiWriter::write(image, &buffer);
+        qint64 encodeNsecs = timer.nsecsElapsed();
+        timer.start();
+        QoiReader::decode(data);
+        report("QOI", image, encodeNsecs, timer.nsecsElapsed(), data.size());
+    }
+}
+
+void ExportBenchmark::compareResamplers(const QImage &image, const QSize &size)
+{
+    // 吞吐量按输入像素计算，便于比较放大和缩小
+    auto reportResample = [&image, &size](const QString &name, qint64 nsecs) {
+        double ms = nsecs / 1e6;
+        double megapixels = double(image.width()) * image.height() / 1e6;
+        qDebug().noquote() << QString("ExportBenchmark: %1 %2x%3 -> %4x%5 resample %6 ms (%7 MP/s)")
+                                  .arg(name)
+                                  .arg(image.width())
+                                  .arg(image.height())
+                                  .arg(size.width())
+                                  .arg(size.height())
+                                  .arg(ms, 0, 'f', 1)
+                                  .arg(ms > 0 ? megapixels / (ms / 1000.0) : 0.0, 0, 'f', 1);
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    reportResample("QImage::scaled smooth", timer.nsecsElapsed());
+
+    const ImageResampler::Filter filters[] = {ImageResampler::Box, ImageResampler::Lanczos3};
+    for (ImageResampler::Filter filter : filters) {
+        timer.start();
+        ImageResampler(filter).resample(image, size);
+        reportResample("ImageResampler " + ImageResampler::filterName(filter), timer.nsecsElapsed());
+    }
+}
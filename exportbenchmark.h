@@ -0,0 +1,16 @@
+#ifndef EXPORTBENCHMARK_H
+#define EXPORTBENCHMARK_H
+
+#include <QImage>
+
+// 导出阶段的性能对比。设置环境变量 SCREENSHOT_BENCHMARK 后，
+// 导出流水线会在编码阶段用同一张图额外跑一遍各编码器并输出耗时和体积；
+// 导出时需要缩放的话，合成阶段还会对比各种缩放方式的吞吐量。
+class ExportBenchmark {
+public:
+    static bool isEnabled();
+    static void compareEncoders(const QImage &image);
+    static void compareResamplers(const QImage &image, const QSize &size);
+};
+
+#endif // EXPORTBENCHMARK_H
@@ -0,0 +1,257 @@
+#include "exportpipeline.h"
+#include "shaperenderer.h"
+#include "exportbenchmark.h"
+#include "qoicodec.h"
+#include "lazyimagemimedata.h"
+#include "colorquantizer.h"
+#include "vectorexporter.h"
+#include "capturearchive.h"
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegularExpression>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QTimer>
+#include <QDebug>
+
+// 切片导出时每个输出文件一项，在线程池中并行编码和写入
+struct SliceOutput {
+    QString filePath;
+    QImage image;
+    bool ok = false;
+};
+
+ExportPipeline::ExportPipeline(QObject *parent)
+    : QObject(parent)
+{
+}
+
+template <typename Work, typename Done>
+void ExportPipeline::runStage(Work work, Done done)
+{
+    QThreadPool::globalInstance()->start(QRunnable::create([this, work, done]() {
+        auto result = work();
+        QMetaObject::invokeMethod(this, [done, result]() { done(result); }, Qt::QueuedConnection);
+    }));
+}
+
+void ExportPipeline::start(const ExportJob &job)
+{
+    if (running) {
+        qDebug() << "ExportPipeline: Already running, request ignored";
+        return;
+    }
+    running = true;
+    deliveryConfirmed = false;
+    currentJob = job;
+    timer.start();
+    qDebug() << "ExportPipeline: Started, viewport:" << job.viewport << ", shapes:" << job.shapes.size();
+
+    if (job.filePath.isEmpty()) {
+        deliver();
+        return;
+    }
+    if (job.format == ExportJob::Pdf || job.format == ExportJob::Svg) {
+        // 矢量导出不需要合成整幅位图，直接在工作线程中写文件
+        runStage([job]() { return VectorExporter::write(job); },
+                 [this](bool ok) {
+                     finishFileDelivery(ok);
+                 });
+        return;
+    }
+
+    runStage([job]() { return flatten(job); },
+             [this](const QImage &image) {
+                 qDebug() << "ExportPipeline: Flatten done at" << timer.elapsed() << "ms";
+                 if (image.isNull()) {
+                     running = false;
+                     emit failed("合成图像失败");
+                     return;
+                 }
+                 // 整幅 PNG 等编码完成后连同编码结果一起归档，其它格式和切片导出在这里归档
+                 if (CaptureArchive::isEnabled() && (currentJob.format != ExportJob::Png || !currentJob.slices.isEmpty())) {
+                     CaptureArchive::add(image, QFileInfo(currentJob.filePath).fileName());
+                 }
+                 encode(image);
+             });
+}
+
+QImage ExportPipeline::flatten(const ExportJob &job)
+{
+    QImage image = job.capture.copy(job.viewport);
+    if (image.isNull()) {
+        return image;
+    }
+    // 只缩放截图本身，形状按目标分辨率重新绘制，箭头和文字不会被插值模糊
+    if (job.outputSize.isValid() && !job.outputSize.isEmpty() && job.outputSize != image.size()) {
+        if (ExportBenchmark::isEnabled()) {
+            ExportBenchmark::compareResamplers(image, job.outputSize);
+        }
+        image = ImageResampler(job.resampleFilter).resample(image, job.outputSize);
+    }
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(double(image.width()) / job.viewport.width(), double(image.height()) / job.viewport.height());
+    painter.translate(-job.viewport.topLeft());
+    ShapeRenderer::drawAll(painter, job.shapes);
+    painter.end();
+    return image;
+}
+
+void ExportPipeline::encode(const QImage &image)
+{
+    if (!currentJob.slices.isEmpty()) {
+        writeSlices(image);
+        return;
+    }
+    if (!currentJob.filePath.isEmpty() && currentJob.format == ExportJob::Qoi) {
+        streamQoiToFile(image);
+        return;
+    }
+
+    PngEncoder::Preset preset = currentJob.pngPreset;
+    bool quantize = currentJob.quantize;
+    bool dither = currentJob.dither;
+    runStage([image, preset, quantize, dither]() {
+                 if (ExportBenchmark::isEnabled()) {
+                     ExportBenchmark::compareEncoders(image);
+                 }
+                 if (quantize) {
+                     QImage indexed = ColorQuantizer(256, dither).quantize(image);
+                     if (!indexed.isNull()) {
+                         QByteArray png = PngEncoder(preset).encode(indexed);
+                         qDebug() << "ExportPipeline: Palette PNG" << png.size() << "bytes,"
+                                  << double(png.size()) / (qint64(image.width()) * image.height()) << "bytes/pixel";
+                         return png;
+                     }
+                 }
+                 return PngEncoder(preset).encode(image);
+             },
+             [this, image](const QByteArray &png) {
+                 qDebug() << "ExportPipeline: Encode done at" << timer.elapsed() << "ms, bytes:" << png.size();
+                 deliverToFile(png);
+                 if (CaptureArchive::isEnabled() && !png.isEmpty()) {
+                     CaptureArchive::add(image, QFileInfo(currentJob.filePath).fileName(), png);
+                 }
+             });
+}
+
+void ExportPipeline::deliverToFile(const QByteArray &data)
+{
+    QString filePath = currentJob.filePath;
+    runStage([filePath, data]() {
+                 QSaveFile file(filePath);
+                 return !data.isEmpty() && file.open(QIODevice::WriteOnly)
+                        && file.write(data) == data.size() && file.commit();
+             },
+             [this](bool ok) {
+                 finishFileDelivery(ok);
+             });
+}
+
+void ExportPipeline::streamQoiToFile(const QImage &image)
+{
+    // QOI 编码和写文件合并为一个阶段：编码器逐行产出数据并分块写入文件
+    QString filePath = currentJob.filePath;
+    runStage([filePath, image]() {
+                 if (ExportBenchmark::isEnabled()) {
+                     ExportBenchmark::compareEncoders(image);
+                 }
+                 QSaveFile file(filePath);
+                 return file.open(QIODevice::WriteOnly) && QoiWriter::write(image, &file) && file.commit();
+             },
+             [this](bool ok) {
+                 finishFileDelivery(ok);
+             });
+}
+
+void ExportPipeline::writeSlices(const QImage &image)
+{
+    // 合成只做了一次，各切片直接从合成结果中截取
+    QFileInfo info(currentJob.filePath);
+    QString base = info.dir().filePath(info.completeBaseName());
+    QList<SliceOutput> outputs;
+    outputs.append({currentJob.filePath, image});
+    for (const ExportSlice &slice : currentJob.slices) {
+        QRect rect = slice.rect.translated(-currentJob.viewport.topLeft()) & image.rect();
+        if (rect.isEmpty()) {
+            continue;
+        }
+        QString name = slice.name;
+        name.replace(QRegularExpression("[\\\\/:*?\"<>|\\s]"), "_");
+        outputs.append({base + "_" + name + ".png", image.copy(rect)});
+    }
+
+    PngEncoder::Preset preset = currentJob.pngPreset;
+    runStage([outputs, preset]() {
+                 QElapsedTimer timer;
+                 timer.start();
+                 QList<SliceOutput> files = outputs;
+                 QtConcurrent::blockingMap(files, [preset](SliceOutput &output) {
+                     QByteArray png = PngEncoder(preset).encode(output.image);
+                     QSaveFile file(output.filePath);
+                     output.ok = !png.isEmpty() && file.open(QIODevice::WriteOnly)
+                                 && file.write(png) == png.size() && file.commit();
+                 });
+                 bool ok = true;
+                 for (const SliceOutput &output : files) {
+                     if (!output.ok) {
+                         qDebug() << "ExportPipeline: Failed to write slice" << output.filePath;
+                         ok = false;
+                     }
+                 }
+                 qDebug() << "ExportPipeline: Wrote" << files.size() << "files in" << timer.elapsed() << "ms";
+                 return ok;
+             },
+             [this](bool ok) {
+                 finishFileDelivery(ok);
+             });
+}
+
+void ExportPipeline::finishFileDelivery(bool ok)
+{
+    running = false;
+    if (!ok) {
+        emit failed(QString("无法写入文件: %1").arg(currentJob.filePath));
+        return;
+    }
+    qDebug() << "ExportPipeline: Saved to" << currentJob.filePath << ", finish-click-to-done:" << timer.elapsed() << "ms";
+    emit delivered();
+}
+
+void ExportPipeline::deliver()
+{
+    QClipboard *clipboard = QGuiApplication::clipboard();
+    LazyImageMimeData *mimeData = new LazyImageMimeData(currentJob);
+
+    connect(clipboard, &QClipboard::dataChanged, this, [this]() {
+        confirmDelivery("dataChanged");
+    });
+    clipboard->setMimeData(mimeData);
+
+    // 多数平台在 setMimeData 后立即拥有剪贴板，不必再等待信号
+    if (clipboard->ownsClipboard()) {
+        confirmDelivery("ownsClipboard");
+    } else {
+        QTimer::singleShot(1000, this, [this]() {
+            confirmDelivery("timeout");
+        });
+    }
+}
+
+void ExportPipeline::confirmDelivery(const char *source)
+{
+    if (deliveryConfirmed) {
+        return;
+    }
+    deliveryConfirmed = true;
+    running = false;
+    disconnect(QGuiApplication::clipboard(), &QClipboard::dataChanged, this, nullptr);
+    qDebug() << "ExportPipeline: Delivered via" << source << ", finish-click-to-done:" << timer.elapsed() << "ms";
+    emit delivered();
+}
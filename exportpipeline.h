@@ -0,0 +1,72 @@
+#ifndef EXPORTPIPELINE_H
+#define EXPORTPIPELINE_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QList>
+#include <QElapsedTimer>
+#include "shape.h"
+#include "pngencoder.h"
+#include "imageresampler.h"
+
+// 命名的导出区域，坐标基于原始截图
+struct ExportSlice {
+    QString name;
+    QRect rect;
+};
+
+// 一次导出所需的全部数据，都是隐式共享的值，可以安全地交给工作线程
+struct ExportJob {
+    enum Format { Png, Qoi, Pdf, Svg };
+
+    QImage capture;     // 原始截图
+    QRect viewport;     // 选区在原始截图中的位置
+    QList<Shape> shapes; // 形状（原始截图坐标）
+    QString filePath;   // 为空时交付到剪贴板，否则写入该文件
+    QSize outputSize;   // 无效时保持选区原始尺寸，否则缩放到该尺寸
+    ImageResampler::Filter resampleFilter = ImageResampler::Lanczos3;
+    Format format = Png;
+    PngEncoder::Preset pngPreset = PngEncoder::Balanced;
+    bool quantize = false; // 先量化为调色板再写索引色 PNG，误差过大时自动退回真彩色
+    bool dither = false;
+    QList<ExportSlice> slices; // 非空时整幅图写入 filePath，各切片写入 “文件名_切片名.png”
+};
+
+// 导出流水线：合成(flatten) -> 编码(encode) -> 交付(deliver)。
+// 写文件时前两个阶段在线程池中执行，每个阶段完成后通过回调回到主线程启动下一阶段；
+// 交付到剪贴板时直接放入按需编码的 LazyImageMimeData，合成和编码推迟到有程序粘贴时。
+// 此时 delivered 只表示编辑器可以关闭；数据仍由本进程按需提供，进程要等剪贴板被接管后才能退出。
+class ExportPipeline : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ExportPipeline(QObject *parent = nullptr);
+    void start(const ExportJob &job);
+    bool isRunning() const { return running; }
+
+    static QImage flatten(const ExportJob &job);
+
+signals:
+    void delivered();
+    void failed(const QString &reason);
+
+private:
+    QElapsedTimer timer;
+    ExportJob currentJob;
+    bool running = false;
+    bool deliveryConfirmed = false;
+
+    template <typename Work, typename Done>
+    void runStage(Work work, Done done);
+
+    void encode(const QImage &image);
+    void deliver();
+    void deliverToFile(const QByteArray &data);
+    void streamQoiToFile(const QImage &image);
+    void writeSlices(const QImage &image);
+    void finishFileDelivery(bool ok);
+    void confirmDelivery(const char *source);
+};
+
+#endif // EXPORTPIPELINE_H
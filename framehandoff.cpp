@@ -0,0 +1,93 @@
+#include "framehandoff.h"
+#include <QSharedMemory>
+#include <QCoreApplication>
+#include <QAtomicInt>
+#include <QDebug>
+#include <cstring>
+
+static const char Magic[8] = {'S', 'S', 'H', 'O', 'T', 'S', 'H', 'M'};
+static const int DataAlignment = 64;
+
+// 映射在 QImage 生命周期内保持有效，最后一个引用释放时由 release() 清理
+struct AttachedFrame {
+    QSharedMemory *segment;
+    std::function<void()> onRelease;
+};
+
+QString FrameHandoff::nextKey()
+{
+    static QAtomicInt counter;
+    return QString("ScreenshotTool-frame-%1-%2").arg(QCoreApplication::applicationPid()).arg(counter.fetchAndAddRelaxed(1));
+}
+
+QSharedMemory *FrameHandoff::create(const QString &key, const QSize &size, QImage::Format format, QImage &target)
+{
+    const int depth = QImage::toPixelFormat(format).bitsPerPixel();
+    if (size.isEmpty() || depth != 32) {
+        return nullptr;
+    }
+    const qsizetype bytesPerLine = qsizetype(size.width()) * 4;
+    const qsizetype dataOffset = (qsizetype(sizeof(Header)) + DataAlignment - 1) / DataAlignment * DataAlignment;
+    QSharedMemory *segment = new QSharedMemory(key);
+    if (!segment->create(dataOffset + bytesPerLine * size.height())) {
+        qDebug() << "FrameHandoff: Failed to create segment" << key << ":" << segment->errorString();
+        delete segment;
+        return nullptr;
+    }
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.width = quint32(size.width());
+    header.height = quint32(size.height());
+    header.format = quint32(format);
+    header.bytesPerLine = quint32(bytesPerLine);
+    header.dataOffset = quint32(dataOffset);
+    uchar *base = static_cast<uchar *>(segment->data());
+    memcpy(base, &header, sizeof(header));
+    target = QImage(base + dataOffset, size.width(), size.height(), bytesPerLine, format);
+    return segment;
+}
+
+void FrameHandoff::release(void *info)
+{
+    AttachedFrame *frame = static_cast<AttachedFrame *>(info);
+    frame->segment->detach();
+    delete frame->segment;
+    if (frame->onRelease) {
+        frame->onRelease();
+    }
+    delete frame;
+}
+
+QImage FrameHandoff::attach(const QString &key, std::function<void()> onRelease)
+{
+    QSharedMemory *segment = new QSharedMemory(key);
+    if (!segment->attach(QSharedMemory::ReadWrite)) {
+        qDebug() << "FrameHandoff: Failed to attach" << key << ":" << segment->errorString();
+        delete segment;
+        return QImage();
+    }
+    // 帧头由对方进程写入，逐项校验后才按它解释像素
+    Header header;
+    bool valid = segment->size() >= qsizetype(sizeof(Header));
+    if (valid) {
+        memcpy(&header, segment->constData(), sizeof(header));
+        const qint64 end = qint64(header.dataOffset) + qint64(header.bytesPerLine) * header.height;
+        valid = memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.version == Version
+                && header.format > QImage::Format_Invalid && header.format < QImage::NImageFormats
+                && QImage::toPixelFormat(QImage::Format(header.format)).bitsPerPixel() == 32
+                && header.width > 0 && header.height > 0 && header.dataOffset >= sizeof(Header)
+                && header.dataOffset % DataAlignment == 0
+                && qint64(header.bytesPerLine) >= qint64(header.width) * 4 && end <= segment->size();
+    }
+    if (!valid) {
+        qDebug() << "FrameHandoff: Invalid frame header in" << key;
+        delete segment;
+        return QImage();
+    }
+    AttachedFrame *frame = new AttachedFrame{segment, std::move(onRelease)};
+    uchar *pixels = static_cast<uchar *>(segment->data()) + header.dataOffset;
+    return QImage(pixels, int(header.width), int(header.height), qsizetype(header.bytesPerLine),
+                  QImage::Format(header.format), &FrameHandoff::release, frame);
+}
@@ -0,0 +1,40 @@
+#ifndef FRAMEHANDOFF_H
+#define FRAMEHANDOFF_H
+
+#include <QImage>
+#include <QString>
+#include <functional>
+
+class QSharedMemory;
+
+// 常驻抓取进程和编辑进程之间通过共享内存交接整屏帧。
+// 共享内存段开头是 64 字节的帧头（魔数、版本、宽、高、QImage 格式、每行字节数、像素偏移），
+// 之后是 64 字节对齐的像素。编辑进程直接在映射的内存上构造 QImage，不复制像素；
+// 最后一个引用释放时断开映射并调用 onRelease，由调用方通过本地套接字通知抓取进程回收。
+class FrameHandoff {
+public:
+    // 抓取端：创建共享内存段，target 指向段内的像素，由调用方填充。失败时返回 nullptr
+    static QSharedMemory *create(const QString &key, const QSize &size, QImage::Format format, QImage &target);
+    // 编辑端：映射共享内存段并校验帧头，失败时返回空图像
+    static QImage attach(const QString &key, std::function<void()> onRelease);
+
+    static QString nextKey(); // 本进程内唯一的段名
+
+private:
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 width;
+        quint32 height;
+        quint32 format;
+        quint32 bytesPerLine;
+        quint32 dataOffset;
+        char reserved[32];
+    };
+    static_assert(sizeof(Header) == 64, "FrameHandoff header must stay 64 bytes");
+
+    static const quint32 Version = 1;
+    static void release(void *info);
+};
+
+#endif // FRAMEHANDOFF_H
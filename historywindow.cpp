@@ -0,0 +1,44 @@
+#include "historywindow.h"
+#include "capturehistory.h"
+#include <QListWidget>
+#include <QVBoxLayout>
+#include <QPixmap>
+#include <QDebug>
+
+HistoryWindow::HistoryWindow(QWidget *parent)
+    : QWidget(parent)
+{
+    setWindowTitle("最近的截图");
+    resize(760, 520);
+
+    list = new QListWidget(this);
+    list->setViewMode(QListView::IconMode);
+    list->setIconSize(QSize(160, 120));
+    list->setResizeMode(QListView::Adjust);
+    list->setMovement(QListView::Static);
+    list->setSpacing(8);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(list);
+    layout->setContentsMargins(5, 5, 5, 5);
+    setLayout(layout);
+
+    connect(list, &QListWidget::itemActivated, this, [this](QListWidgetItem *item) {
+        emit openRequested(item->data(Qt::UserRole).toString());
+    });
+    reload();
+}
+
+void HistoryWindow::reload()
+{
+    list->clear();
+    const QList<HistoryEntry> entries = CaptureHistory::entries();
+    for (const HistoryEntry &entry : entries) {
+        QListWidgetItem *item = new QListWidgetItem(QIcon(QPixmap::fromImage(entry.thumbnail)),
+                                                    entry.time.toString("MM-dd HH:mm:ss"), list);
+        item->setData(Qt::UserRole, entry.filePath);
+        item->setToolTip(QString("%1x%2, %3 KB").arg(entry.size.width()).arg(entry.size.height())
+                         .arg((entry.bytes + 512) / 1024));
+    }
+    qDebug() << "HistoryWindow: Listed" << entries.size() << "entries";
+}
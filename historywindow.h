@@ -0,0 +1,23 @@
+#ifndef HISTORYWINDOW_H
+#define HISTORYWINDOW_H
+
+#include <QWidget>
+
+class QListWidget;
+
+// 最近截图列表，双击重新打开到编辑器中
+class HistoryWindow : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit HistoryWindow(QWidget *parent = nullptr);
+    void reload();
+
+signals:
+    void openRequested(const QString &filePath);
+
+private:
+    QListWidget *list;
+};
+
+#endif // HISTORYWINDOW_H
@@ -0,0 +1,68 @@
+#include "imageloader.h"
+#include <QImageReader>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QElapsedTimer>
+#include <QDebug>
+
+static const qint64 PreviewMinPixels = 4 * 1024 * 1024; // 更小的图片完整解码已经足够快
+static const int PreviewMaxSide = 1024;
+static const int AllocationLimitMB = 2048;           // Qt 默认 256MB，放不下大尺寸截图
+
+static QImage decodePreview(const QString &filePath)
+{
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+    QSize scaled = reader.size();
+    scaled.scale(QSize(PreviewMaxSide, PreviewMaxSide), Qt::KeepAspectRatio);
+    reader.setScaledSize(scaled);
+    return reader.read();
+}
+
+static QImage decodeImage(const QString &filePath)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+    QImage image = reader.read();
+    qDebug() << "ImageLoader: Decoded" << filePath << image.size() << "in" << timer.elapsed() << "ms";
+    return image;
+}
+
+ImageLoader::ImageLoader(const QString &filePath, QObject *parent)
+    : QObject(parent), filePath(filePath)
+{
+    QImageReader::setAllocationLimit(AllocationLimitMB);
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+    size = reader.size();
+    if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+        size.transpose();
+    }
+    canPreview = reader.format() == "jpeg" && reader.supportsOption(QImageIOHandler::ScaledSize)
+                 && qint64(size.width()) * size.height() >= PreviewMinPixels;
+
+    connect(&previewWatcher, &QFutureWatcher<QImage>::finished, this, [this]() {
+        // 完整图像先到时丢弃预览
+        QImage preview = previewWatcher.result();
+        if (!preview.isNull() && !imageWatcher.isFinished()) {
+            emit previewReady(preview);
+        }
+    });
+    connect(&imageWatcher, &QFutureWatcher<QImage>::finished, this, [this]() {
+        QImage image = imageWatcher.result();
+        if (image.isNull()) {
+            emit failed(QString("无法解码 %1").arg(this->filePath));
+        } else {
+            emit imageReady(image);
+        }
+    });
+}
+
+void ImageLoader::start()
+{
+    if (canPreview) {
+        previewWatcher.setFuture(QtConcurrent::run(decodePreview, filePath));
+    }
+    imageWatcher.setFuture(QtConcurrent::run(decodeImage, filePath));
+}
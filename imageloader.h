@@ -0,0 +1,36 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QObject>
+#include <QImage>
+#include <QFutureWatcher>
+
+// 在后台线程解码要标注的图片文件。
+// 尺寸在构造时从文件头读出，编辑器可以立即按正确大小打开；
+// JPEG 先用 DCT 缩放解码出低分辨率预览（只需完整解码的一小部分时间），保持小尺寸交给编辑器缩放显示，
+// 同时并行解码完整分辨率，完成后替换预览。其它格式没有廉价的缩小解码，只做完整解码，
+// 例如 PNG 的缩小解码也要解压并反滤波每一行，解码完成前编辑器显示灰色占位图。
+class ImageLoader : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ImageLoader(const QString &filePath, QObject *parent = nullptr);
+
+    bool isValid() const { return size.isValid(); }
+    QSize imageSize() const { return size; }
+    void start();
+
+signals:
+    void previewReady(const QImage &preview);
+    void imageReady(const QImage &image);
+    void failed(const QString &reason);
+
+private:
+    QString filePath;
+    QSize size;
+    bool canPreview = false;
+    QFutureWatcher<QImage> previewWatcher;
+    QFutureWatcher<QImage> imageWatcher;
+};
+
+#endif // IMAGELOADER_H
@@ -0,0 +1,215 @@
+#include "imageresampler.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QThread>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+
+static const int WeightBits = 14;
+static const double Pi = 3.14159265358979323846;
+
+// 一个输出像素的权重：从 first 开始的 weights.size() 个输入像素
+struct Contribution {
+    int first = 0;
+    QVector<int> weights;
+};
+
+struct RowBand {
+    int first = 0;
+    int count = 0;
+};
+
+static double boxKernel(double x)
+{
+    return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+}
+
+static double lanczos3Kernel(double x)
+{
+    x = std::fabs(x);
+    if (x < 1e-8) {
+        return 1.0;
+    }
+    if (x >= 3.0) {
+        return 0.0;
+    }
+    double px = Pi * x;
+    return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+}
+
+// 缩小时按比例放宽卷积核，使每个输出像素覆盖对应的全部输入像素
+static QVector<Contribution> contributions(int inSize, int outSize, ImageResampler::Filter filter)
+{
+    double scale = double(inSize) / outSize;
+    double filterScale = qMax(1.0, scale);
+    double radius = filter == ImageResampler::Box ? 0.5 : 3.0;
+    double support = radius * filterScale;
+    auto kernel = filter == ImageResampler::Box ? boxKernel : lanczos3Kernel;
+
+    QVector<Contribution> result(outSize);
+    QVector<double> raw;
+    for (int i = 0; i < outSize; ++i) {
+        double center = (i + 0.5) * scale;
+        int first = qMax(0, int(std::floor(center - support)));
+        int last = qMin(inSize, int(std::ceil(center + support)));
+        raw.clear();
+        double total = 0;
+        for (int x = first; x < last; ++x) {
+            double w = kernel((x + 0.5 - center) / filterScale);
+            raw.append(w);
+            total += w;
+        }
+        if (total == 0) {
+            // 放大时盒子核可能落在两个像素之间，退化为最近邻
+            first = qBound(0, int(center), inSize - 1);
+            raw = {1.0};
+            total = 1.0;
+        }
+        // 去掉两端为零的权重，减少内层循环次数
+        int begin = 0;
+        int end = raw.size();
+        while (begin < end && raw[begin] == 0) ++begin;
+        while (end > begin && raw[end - 1] == 0) --end;
+
+        Contribution &c = result[i];
+        c.first = first + begin;
+        for (int k = begin; k < end; ++k) {
+            c.weights.append(int(std::lround(raw[k] / total * (1 << WeightBits))));
+        }
+    }
+    return result;
+}
+
+static inline uchar clampChannel(int value)
+{
+    value = (value + (1 << (WeightBits - 1))) >> WeightBits;
+    return uchar(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// 预乘格式要求颜色分量不超过 alpha，Lanczos 的负瓣可能破坏这一点
+static inline void storePixel(uchar *out, const int sum[4])
+{
+    uchar alpha = clampChannel(sum[3]);
+    out[3] = alpha;
+    for (int c = 0; c < 3; ++c) {
+        out[c] = qMin(clampChannel(sum[c]), alpha);
+    }
+}
+
+static QVector<RowBand> rowBands(int rows)
+{
+    int threads = qMax(1, QThread::idealThreadCount());
+    int perBand = qMax(16, (rows + threads * 2 - 1) / (threads * 2));
+    QVector<RowBand> bands;
+    for (int y = 0; y < rows; y += perBand) {
+        bands.append({y, qMin(perBand, rows - y)});
+    }
+    return bands;
+}
+
+static void resampleHorizontal(const QImage &in, QImage &out, const QVector<Contribution> &table)
+{
+    const uchar *inBits = in.constBits();
+    qsizetype inStride = in.bytesPerLine();
+    uchar *outBits = out.bits();
+    qsizetype outStride = out.bytesPerLine();
+    int outWidth = out.width();
+    QVector<RowBand> bands = rowBands(in.height());
+    QtConcurrent::blockingMap(bands, [=, &table](const RowBand &band) {
+        for (int y = band.first; y < band.first + band.count; ++y) {
+            const uchar *src = inBits + y * inStride;
+            uchar *dst = outBits + y * outStride;
+            for (int x = 0; x < outWidth; ++x) {
+                const Contribution &c = table[x];
+                const uchar *p = src + c.first * 4;
+                const int *w = c.weights.constData();
+                int sum[4] = {0, 0, 0, 0};
+                for (int k = 0; k < c.weights.size(); ++k, p += 4) {
+                    sum[0] += p[0] * w[k];
+                    sum[1] += p[1] * w[k];
+                    sum[2] += p[2] * w[k];
+                    sum[3] += p[3] * w[k];
+                }
+                storePixel(dst + x * 4, sum);
+            }
+        }
+    });
+}
+
+static void resampleVertical(const QImage &in, QImage &out, const QVector<Contribution> &table)
+{
+    const uchar *inBits = in.constBits();
+    qsizetype inStride = in.bytesPerLine();
+    uchar *outBits = out.bits();
+    qsizetype outStride = out.bytesPerLine();
+    int rowBytes = out.width() * 4;
+    QVector<RowBand> bands = rowBands(out.height());
+    QtConcurrent::blockingMap(bands, [=, &table](const RowBand &band) {
+        // 按整行累加，内层循环沿内存连续方向
+        QVector<int> sums(rowBytes);
+        for (int y = band.first; y < band.first + band.count; ++y) {
+            const Contribution &c = table[y];
+            sums.fill(0);
+            int *acc = sums.data();
+            for (int k = 0; k < c.weights.size(); ++k) {
+                const uchar *src = inBits + (c.first + k) * inStride;
+                int w = c.weights[k];
+                for (int i = 0; i < rowBytes; ++i) {
+                    acc[i] += src[i] * w;
+                }
+            }
+            uchar *dst = outBits + y * outStride;
+            for (int x = 0; x < rowBytes; x += 4) {
+                storePixel(dst + x, acc + x);
+            }
+        }
+    });
+}
+
+ImageResampler::ImageResampler(Filter filter)
+    : filter(filter)
+{
+}
+
+QString ImageResampler::filterName(Filter filter)
+{
+    switch (filter) {
+    case Box: return "box";
+    case Lanczos3: return "lanczos3";
+    }
+    return QString();
+}
+
+QImage ImageResampler::resample(const QImage &image, const QSize &size) const
+{
+    if (image.isNull() || size.isEmpty()) {
+        return QImage();
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    // RGBA8888 的字节顺序与平台无关，alpha 固定在每个像素的第 4 个字节
+    const QImage::Format format = QImage::Format_RGBA8888_Premultiplied;
+    QImage source = image.format() == format ? image : image.convertToFormat(format);
+
+    QImage horizontal = source;
+    if (size.width() != source.width()) {
+        horizontal = QImage(size.width(), source.height(), format);
+        resampleHorizontal(source, horizontal, contributions(source.width(), size.width(), filter));
+    }
+    QImage result = horizontal;
+    if (size.height() != horizontal.height()) {
+        result = QImage(size, format);
+        resampleVertical(horizontal, result, contributions(horizontal.height(), size.height(), filter));
+    }
+    // 转回调用方的格式：不透明的截图回到 RGB32，编码器据此写出不带 alpha 的 PNG/QOI
+    const QImage::Format outputFormat = image.hasAlphaChannel() ? image.format() : QImage::Format_RGB32;
+    if (result.format() != outputFormat) {
+        result.convertTo(outputFormat);
+    }
+
+    qDebug() << "ImageResampler:" << filterName(filter) << image.size() << "->" << size
+             << ", time:" << timer.elapsed() << "ms";
+    return result;
+}
@@ -0,0 +1,40 @@
+#include "layerbufferpool.h"
+#include <QDebug>
+
+LayerBufferPool::LayerBufferPool(QImage::Format format)
+    : format(format)
+{
+}
+
+int LayerBufferPool::bytesPerPixel() const
+{
+    return QImage::toPixelFormat(format).bitsPerPixel() / 8;
+}
+
+QImage LayerBufferPool::acquire(const QSize &size)
+{
+    if (size.isEmpty()) {
+        return QImage();
+    }
+
+    if (size.width() > capacitySize.width() || size.height() > capacitySize.height()) {
+        // 每个方向按 1.5 倍增长，连续的小幅放大不会每次都触发分配
+        int newWidth = qMax(size.width(), capacitySize.width() + capacitySize.width() / 2);
+        int newHeight = qMax(size.height(), capacitySize.height() + capacitySize.height() / 2);
+        if (limit.isValid()) {
+            newWidth = qMax(size.width(), qMin(newWidth, limit.width()));
+            newHeight = qMax(size.height(), qMin(newHeight, limit.height()));
+        }
+        qint64 newBytes = qint64(newWidth) * newHeight * bytesPerPixel();
+
+        buffer = QByteArray();
+        buffer.resize(newBytes);
+        capacitySize = QSize(newWidth, newHeight);
+        counters.allocations++;
+        counters.bytes += newBytes;
+        qDebug() << "LayerBufferPool: Grew capacity to:" << capacitySize << ", bytes:" << newBytes;
+    }
+
+    int bytesPerLine = capacitySize.width() * bytesPerPixel();
+    return QImage(reinterpret_cast<uchar *>(buffer.data()), size.width(), size.height(), bytesPerLine, format);
+}
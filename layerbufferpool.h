@@ -0,0 +1,38 @@
+#ifndef LAYERBUFFERPOOL_H
+#define LAYERBUFFERPOOL_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QSize>
+
+// 编辑图层的缓冲池：底层缓冲按几何级数增长并被反复复用，
+// 返回的 QImage 只是缓冲上的一个逻辑尺寸视图（行跨度等于容量宽度）。
+class LayerBufferPool {
+public:
+    struct Stats {
+        int allocations = 0;
+        qint64 bytes = 0;
+    };
+
+    explicit LayerBufferPool(QImage::Format format = QImage::Format_ARGB32_Premultiplied);
+
+    // 获取指定逻辑尺寸的图层；容量不足时才重新分配，之前返回的视图随之失效
+    QImage acquire(const QSize &size);
+    QSize capacity() const { return capacitySize; }
+    // 容量增长的上限，通常是原始截图尺寸，选区不可能超过它
+    void setLimit(const QSize &size) { limit = size; }
+
+    Stats stats() const { return counters; }
+    void resetStats() { counters = Stats(); }
+
+private:
+    QImage::Format format;
+    QByteArray buffer;
+    QSize capacitySize;
+    QSize limit;
+    Stats counters;
+
+    int bytesPerPixel() const;
+};
+
+#endif // LAYERBUFFERPOOL_H
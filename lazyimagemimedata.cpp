@@ -0,0 +1,126 @@
+#include "lazyimagemimedata.h"
+#include "pngencoder.h"
+#include "capturearchive.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QBuffer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QUrl>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDebug>
+
+static const QString ImageMimeType = "application/x-qt-image"; // 平台剪贴板据此转换成原生位图格式
+static const QString PngMimeType = "image/png";
+static const QString BmpMimeType = "image/bmp";
+static const QString HtmlMimeType = "text/html";         // <img src="data:image/png;base64,...">
+static const QString UriListMimeType = "text/uri-list";  // 临时 PNG 文件的路径
+static const qint64 TempFileLifetimeSecs = 24 * 60 * 60;  // 临时 PNG 的保留时间
+
+LazyImageMimeData::LazyImageMimeData(const ExportJob &job)
+{
+    flattened = QtConcurrent::run([job]() {
+        QImage image = ExportPipeline::flatten(job);
+        // 复制到剪贴板同样算一次完成的截图，合成结束就归档，不等有程序粘贴
+        if (CaptureArchive::isEnabled() && !image.isNull()) {
+            CaptureArchive::add(image, "clipboard");
+        }
+        return image;
+    });
+}
+
+LazyImageMimeData::~LazyImageMimeData()
+{
+    // 临时文件不在这里删除：粘贴方拿到的只是路径，可能在本进程退出后才去读取文件。
+    // 旧文件在下次生成临时文件时按保留时间清理
+    flattened.waitForFinished();
+}
+
+// 删除剪贴板临时目录中超过保留时间的文件，返回该目录
+static QDir clipboardTempDir()
+{
+    QDir dir(QDir::temp().filePath("screenshot-clipboard"));
+    dir.mkpath(".");
+    const QDateTime expiry = QDateTime::currentDateTime().addSecs(-TempFileLifetimeSecs);
+    const QFileInfoList files = dir.entryInfoList({"screenshot_*.png"}, QDir::Files);
+    for (const QFileInfo &info : files) {
+        if (info.lastModified() < expiry) {
+            QFile::remove(info.filePath());
+        }
+    }
+    return dir;
+}
+
+QStringList LazyImageMimeData::formats() const
+{
+    return {ImageMimeType, PngMimeType, BmpMimeType, HtmlMimeType, UriListMimeType};
+}
+
+bool LazyImageMimeData::hasFormat(const QString &mimeType) const
+{
+    return formats().contains(mimeType);
+}
+
+QImage LazyImageMimeData::image() const
+{
+    return flattened.result();
+}
+
+QByteArray LazyImageMimeData::encoded(const QString &mimeType) const
+{
+    auto it = cache.constFind(mimeType);
+    if (it != cache.constEnd()) {
+        return it.value();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray data;
+    if (mimeType == PngMimeType) {
+        data = PngEncoder(PngEncoder::Fastest).encode(image());
+    } else if (mimeType == BmpMimeType) {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        image().save(&buffer, "BMP");
+    } else if (mimeType == HtmlMimeType) {
+        data = "<img src=\"data:image/png;base64," + encoded(PngMimeType).toBase64() + "\">";
+    } else if (mimeType == UriListMimeType) {
+        if (tempFilePath.isEmpty()) {
+            QString name = QDateTime::currentDateTime().toString("'screenshot_'yyyyMMdd_HHmmss_zzz'.png'");
+            QString path = clipboardTempDir().filePath(name);
+            QByteArray png = encoded(PngMimeType);
+            QSaveFile file(path);
+            if (file.open(QIODevice::WriteOnly) && file.write(png) == png.size() && file.commit()) {
+                tempFilePath = path;
+            }
+        }
+        if (!tempFilePath.isEmpty()) {
+            data = QUrl::fromLocalFile(tempFilePath).toEncoded() + "\r\n";
+        }
+    }
+
+    qDebug() << "LazyImageMimeData: Encoded" << mimeType << "on demand in" << timer.elapsed() << "ms, bytes:" << data.size();
+    cache.insert(mimeType, data);
+    return data;
+}
+
+QVariant LazyImageMimeData::retrieveData(const QString &mimeType, QMetaType type) const
+{
+    if (mimeType == ImageMimeType) {
+        qDebug() << "LazyImageMimeData: Image requested as" << type.name();
+        return image();
+    }
+    if (!hasFormat(mimeType)) {
+        return QMimeData::retrieveData(mimeType, type);
+    }
+    QByteArray data = encoded(mimeType);
+    if (mimeType == UriListMimeType && type.id() == QMetaType::QVariantList) {
+        return QVariantList{QUrl::fromLocalFile(tempFilePath)};
+    }
+    if (mimeType == HtmlMimeType && type.id() == QMetaType::QString) {
+        return QString::fromLatin1(data);
+    }
+    return data;
+}
@@ -0,0 +1,36 @@
+#ifndef LAZYIMAGEMIMEDATA_H
+#define LAZYIMAGEMIMEDATA_H
+
+#include <QMimeData>
+#include <QImage>
+#include <QFuture>
+#include <QHash>
+#include <QStringList>
+#include "exportpipeline.h"
+
+// 按需编码的剪贴板数据：只声明支持的格式，真正有程序粘贴时才合成并编码对应格式，
+// 编码结果缓存起来，同一格式被多次请求时不再重复计算。
+// 合成在创建时就交给后台线程预先开始，第一次取数据时等待它完成。
+class LazyImageMimeData : public QMimeData {
+    Q_OBJECT
+
+public:
+    explicit LazyImageMimeData(const ExportJob &job);
+    ~LazyImageMimeData() override;
+
+    QStringList formats() const override;
+    bool hasFormat(const QString &mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
+private:
+    QImage image() const;
+    QByteArray encoded(const QString &mimeType) const;
+
+    mutable QFuture<QImage> flattened;
+    mutable QHash<QString, QByteArray> cache;
+    mutable QString tempFilePath;
+};
+
+#endif // LAZYIMAGEMIMEDATA_H
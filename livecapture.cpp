@@ -0,0 +1,96 @@
+#include "livecapture.h"
+#include <QScreen>
+#include <QPixmap>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QDebug>
+
+#ifdef HAVE_X11
+// Xlib 的宏（None、Bool 等）与 Qt 的名字冲突，必须放在所有 Qt 头文件之后
+#include <X11/Xlib.h>
+#endif
+
+LiveCapture::LiveCapture(QScreen *screen)
+    : screen(screen)
+{
+}
+
+LiveCapture::~LiveCapture()
+{
+    if (thread) {
+        stopping.storeRelease(1);
+        thread->wait();
+        delete thread;
+    }
+}
+
+void LiveCapture::start()
+{
+    if (thread || !screen || !workerGrabSupported()) {
+        return;
+    }
+    thread = QThread::create([this]() {
+        run();
+    });
+    thread->start();
+}
+
+bool LiveCapture::workerGrabSupported()
+{
+    const QString platform = QGuiApplication::platformName();
+    return platform == "xcb" || platform == "windows";
+}
+
+void LiveCapture::run()
+{
+    const int interval = 1000 / FramesPerSecond;
+    int frames = 0;
+    qint64 grabMsTotal = 0;
+    QElapsedTimer timer;
+    while (!stopping.loadAcquire()) {
+        timer.start();
+        QImage frame = screen->grabWindow(0).toImage();
+        if (!frame.isNull()) {
+            buffers[back] = frame;
+            // 发布：后备缓冲成为中间缓冲，换回来的旧中间缓冲作为下一次的后备缓冲
+            back = middle.fetchAndStoreAcqRel(back | Fresh) & IndexMask;
+            ++frames;
+        }
+        qint64 ms = timer.elapsed();
+        grabMsTotal += ms;
+        if (ms < interval) {
+            QThread::msleep(interval - ms);
+        }
+    }
+    qDebug() << "LiveCapture: Captured" << frames << "frames, grab avg" << (frames > 0 ? grabMsTotal / frames : 0) << "ms";
+}
+
+bool LiveCapture::takeLatest(QImage &frame)
+{
+    if (!(middle.loadAcquire() & Fresh)) {
+        return false;
+    }
+    front = middle.fetchAndStoreAcqRel(front) & IndexMask;
+    frame = buffers[front];
+    return true;
+}
+
+// 合成管理器运行时持有 _NET_WM_CM_S<屏幕号> 选择（EWMH 约定），其它平台总是由系统合成
+bool LiveCapture::translucentOverlaySupported()
+{
+#ifdef HAVE_X11
+    if (QGuiApplication::platformName() == "xcb") {
+        Display *display = XOpenDisplay(nullptr);
+        if (!display) {
+            return false;
+        }
+        QByteArray name = "_NET_WM_CM_S" + QByteArray::number(DefaultScreen(display));
+        Atom selection = XInternAtom(display, name.constData(), False);
+        bool composited = XGetSelectionOwner(display, selection) != 0;
+        XCloseDisplay(display);
+        return composited;
+    }
+#endif
+    return true;
+}
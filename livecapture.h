@@ -0,0 +1,47 @@
+#ifndef LIVECAPTURE_H
+#define LIVECAPTURE_H
+
+#include <QImage>
+#include <QAtomicInt>
+
+class QThread;
+class QScreen;
+
+// 截屏遮罩的实时模式：后台线程连续抓取整个屏幕，通过三个槽位把最新的一帧无锁地交给界面线程。
+// 抓取线程写后备槽位，写完后与中间槽位原子交换并标记为新帧；
+// 界面线程只在有新帧时把中间槽位换成自己的前台槽位，双方都不会等待对方。
+// 槽位里交换的只是隐式共享的 QImage：grabWindow 每一帧都分配新的整屏图像（4K 下约 33 MB），像素内存没有复用。
+// 只能在 workerGrabSupported() 为 true 的平台上使用。
+class LiveCapture {
+public:
+    explicit LiveCapture(QScreen *screen);
+    ~LiveCapture(); // 停止并等待抓取线程结束
+
+    void start();
+    bool takeLatest(QImage &frame); // 界面线程调用：有比上次更新的完整帧时返回 true
+
+    // 半透明的遮罩能否透出下面的桌面。X11 上没有合成管理器时（例如 Xvfb），
+    // 半透明窗口会显示成不透明的黑色，这时只能退回定格模式
+    static bool translucentOverlaySupported();
+
+    // QScreen 属于界面线程，grabWindow 没有承诺线程安全；只有 xcb 和 windows 插件可以在工作线程中调用
+    static bool workerGrabSupported();
+
+    static const int FramesPerSecond = 30;
+
+private:
+    static const int IndexMask = 3;
+    static const int Fresh = 4; // 中间缓冲中是尚未被界面线程取走的新帧
+
+    QScreen *screen;
+    QThread *thread = nullptr;
+    QAtomicInt stopping{0};
+    QImage buffers[3];
+    int back = 0;         // 只由抓取线程访问
+    int front = 1;        // 只由界面线程访问
+    QAtomicInt middle{2}; // 低两位是缓冲序号，Fresh 位表示新帧
+
+    void run();
+};
+
+#endif // LIVECAPTURE_H
@@ -1,11 +1,264 @@
 #include "mainwindow.h"
+#include "editwindow.h"
+#include "projectfile.h"
+#include "sessionjournal.h"
+#include "imageloader.h"
+#include "historywindow.h"
+#include "capturearchive.h"
+#include "damagetracker.h"
+#include "framehandoff.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QMessageBox>
+#include <QScreen>
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSharedMemory>
+#include <QElapsedTimer>
+#include <QClipboard>
+
+static int openEditors = 0;
+static HistoryWindow *historyWindow = nullptr;
+
+// 复制到剪贴板的数据是按需编码的，其他程序粘贴时才向本进程要具体格式，
+// 所以编辑结束后本进程还拥有剪贴板时不能退出：关掉所有窗口留在后台，等剪贴板被接管后再退出
+static void quitWhenClipboardReleased()
+{
+    QClipboard *clipboard = QGuiApplication::clipboard();
+    if (!clipboard->ownsClipboard()) {
+        QCoreApplication::quit();
+        return;
+    }
+    qDebug() << "main: Clipboard still owned, staying in background until it is replaced";
+    qApp->setQuitOnLastWindowClosed(false);
+    QObject::connect(clipboard, &QClipboard::dataChanged, qApp, [clipboard]() {
+        if (!clipboard->ownsClipboard()) {
+            qDebug() << "main: Clipboard ownership lost, exiting";
+            QCoreApplication::quit();
+        }
+    });
+}
+
+// 不经过截屏遮罩直接打开的编辑器：各自独立结束，最后一个结束时退出程序
+static EditWindow *openEditor(const QPixmap &capture, const QRect &viewport)
+{
+    EditWindow *editWindow = new EditWindow(capture, viewport);
+    ++openEditors;
+    QObject::connect(editWindow, &EditWindow::sessionEnded, editWindow, [editWindow]() {
+        editWindow->deleteLater();
+        if (--openEditors == 0 && !(historyWindow && historyWindow->isVisible())) {
+            quitWhenClipboardReleased();
+        }
+    });
+    return editWindow;
+}
+
+// 常驻进程监听的本地套接字，按用户区分
+static QString daemonServerName()
+{
+    QByteArray user = qgetenv("USER");
+    if (user.isEmpty()) {
+        user = qgetenv("USERNAME");
+    }
+    return "ScreenshotTool-" + QString::fromLocal8Bit(user);
+}
+
+// 常驻抓取进程在运行时向它要一帧整屏画面。帧放在共享内存中，映射后直接使用，不复制像素；
+// 套接字在本进程结束前保持连接，断开即表示这一帧可以回收
+static QImage requestDaemonFrame(QLocalSocket *socket)
+{
+    QElapsedTimer timer;
+    timer.start();
+    socket->connectToServer(daemonServerName());
+    if (!socket->waitForConnected(200)) {
+        return QImage();
+    }
+    socket->write("capture\n");
+    while (!socket->canReadLine()) {
+        if (!socket->waitForReadyRead(2000)) {
+            return QImage();
+        }
+    }
+    QByteArray reply = socket->readLine().trimmed();
+    if (!reply.startsWith("frame ")) {
+        return QImage();
+    }
+    QByteArray key = reply.mid(6);
+    QImage frame = FrameHandoff::attach(QString::fromUtf8(key), [socket, key]() {
+        // 最后一个引用可能在导出线程中释放，回到套接字所在的线程再通知
+        QMetaObject::invokeMethod(socket, [socket, key]() {
+            if (socket->state() == QLocalSocket::ConnectedState) {
+                socket->write("release " + key + "\n");
+                socket->flush();
+            }
+        }, Qt::QueuedConnection);
+    });
+    qDebug() << "main: Frame handoff" << frame.size() << "took" << timer.elapsed() << "ms";
+    return frame;
+}
+
+// 把跟踪到的帧缓冲复制进新的共享内存段，段挂在套接字下面，收到释放消息或对方断开时销毁
+static QByteArray handOffFrame(DamageTracker &tracker, QLocalSocket *socket)
+{
+    if (!tracker.isAvailable()) {
+        return "none";
+    }
+    QString key = FrameHandoff::nextKey();
+    QImage target;
+    QSharedMemory *segment = FrameHandoff::create(key, tracker.size(), QImage::Format_RGB32, target);
+    if (!segment || !tracker.copyTo(target)) {
+        delete segment;
+        return "none";
+    }
+    segment->setObjectName(key);
+    segment->setParent(socket);
+    return "frame " + key.toUtf8();
+}
+
+// 常驻模式：后台持续跟踪屏幕变化，收到请求时把当前帧通过共享内存交给请求方的编辑进程
+static int runDaemon(QApplication &app)
+{
+    app.setQuitOnLastWindowClosed(false);
+    DamageTracker tracker;
+    tracker.start();
+    QLocalServer server;
+    QLocalServer::removeServer(daemonServerName());
+    if (!server.listen(daemonServerName())) {
+        qDebug() << "main: Failed to listen on" << daemonServerName() << ":" << server.errorString();
+        return 1;
+    }
+    QObject::connect(&server, &QLocalServer::newConnection, &server, [&server, &tracker]() {
+        while (QLocalSocket *socket = server.nextPendingConnection()) {
+            QObject::connect(socket, &QLocalSocket::readyRead, socket, [socket, &tracker]() {
+                while (socket->canReadLine()) {
+                    QByteArray command = socket->readLine().trimmed();
+                    if (command == "capture") {
+                        socket->write(handOffFrame(tracker, socket) + "\n");
+                    } else if (command.startsWith("release ")) {
+                        delete socket->findChild<QSharedMemory *>(QString::fromUtf8(command.mid(8)));
+                    }
+                }
+            });
+            QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    });
+    qDebug() << "main: Daemon listening on" << daemonServerName();
+    return app.exec();
+}
+
+static bool openProject(const QString &filePath)
+{
+    // 原始像素是映射的文件内存，首帧不需要解码
+    ProjectData data;
+    if (!ProjectFile::load(filePath, data)) {
+        qDebug() << "main: Failed to open project:" << filePath;
+        return false;
+    }
+    openEditor(QPixmap::fromImage(data.capture), data.viewport)->applyProject(data);
+    return true;
+}
+
+static bool openImage(const QString &filePath)
+{
+    ImageLoader *loader = new ImageLoader(filePath);
+    if (!loader->isValid()) {
+        qDebug() << "main: Unsupported image:" << filePath;
+        delete loader;
+        return false;
+    }
+    // 编辑器按图片尺寸立即打开，超出屏幕的部分可以拖动选区查看
+    QSize screenSize = QGuiApplication::primaryScreen()->availableGeometry().size();
+    QRect viewport(QPoint(0, 0), loader->imageSize().boundedTo(screenSize));
+    EditWindow *editWindow = openEditor(QPixmap(), viewport);
+    loader->setParent(editWindow);
+    QObject::connect(loader, &ImageLoader::previewReady, editWindow, [editWindow, loader](const QImage &preview) {
+        editWindow->setPreview(preview, loader->imageSize());
+    });
+    QObject::connect(loader, &ImageLoader::imageReady, editWindow, [editWindow, loader](const QImage &image) {
+        editWindow->setCapture(image);
+        loader->deleteLater();
+    });
+    QObject::connect(loader, &ImageLoader::failed, editWindow, [editWindow](const QString &reason) {
+        qDebug() << "main:" << reason;
+        emit editWindow->sessionEnded();
+    });
+    loader->start();
+    return true;
+}
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
-    MainWindow w;
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption historyOption("history", "列出最近的截图，双击重新打开编辑");
+    parser.addOption(historyOption);
+    QCommandLineOption archiveOption("archive", "把完成的截图按内容去重存入该目录", "dir");
+    parser.addOption(archiveOption);
+    QCommandLineOption liveOption("live", "遮罩下的画面持续刷新，按下鼠标时才定格");
+    parser.addOption(liveOption);
+    QCommandLineOption daemonOption("daemon", "常驻后台并跟踪屏幕变化，之后不带参数启动时立即弹出截图遮罩");
+    parser.addOption(daemonOption);
+    parser.addPositionalArgument("files", "要标注的图片，或要继续编辑的 .sshot 项目文件", "[files...]");
+    parser.process(a);
+    if (parser.isSet(archiveOption)) {
+        CaptureArchive::setRoot(parser.value(archiveOption));
+    }
+
+    if (parser.isSet(daemonOption)) {
+        return runDaemon(a);
+    }
+
+    if (parser.isSet(historyOption)) {
+        historyWindow = new HistoryWindow;
+        QObject::connect(historyWindow, &HistoryWindow::openRequested, historyWindow, [](const QString &filePath) {
+            openProject(filePath);
+        });
+        historyWindow->show();
+        int result = a.exec();
+        delete historyWindow;
+        return result;
+    }
+
+    // 打开文件时跳过截屏，每个文件一个编辑器
+    const QStringList files = parser.positionalArguments();
+    if (!files.isEmpty()) {
+        for (const QString &file : files) {
+            if (ProjectFile::isProject(file)) {
+                openProject(file);
+            } else {
+                openImage(file);
+            }
+        }
+        return openEditors > 0 ? a.exec() : 1;
+    }
+
+    // 上次的编辑没有正常结束（崩溃或被强制退出），询问是否恢复最近的一次
+    const QStringList sessions = SessionJournal::pendingSessions();
+    if (!sessions.isEmpty()) {
+        QMessageBox::StandardButton answer = QMessageBox::question(nullptr, "恢复编辑",
+                                                                   "上次的截图编辑没有正常结束，是否恢复？");
+        ProjectData data;
+        bool restored = answer == QMessageBox::Yes && SessionJournal::restore(sessions.first(), data);
+        if (restored) {
+            openEditor(QPixmap::fromImage(data.capture), data.viewport)->applyProject(data);
+        }
+        data = ProjectData(); // 释放映射，之后才能删除旧会话
+        for (const QString &session : sessions) {
+            SessionJournal::remove(session);
+        }
+        if (restored) {
+            return a.exec();
+        }
+    }
+
+    // 有常驻抓取进程时本进程只负责编辑，遮罩直接打开在它交来的帧上
+    QLocalSocket *daemonSocket = new QLocalSocket(&a);
+    MainWindow w(parser.isSet(liveOption), parser.isSet(liveOption) ? QImage() : requestDaemonFrame(daemonSocket));
+    QObject::connect(&w, &MainWindow::sessionEnded, &a, &quitWhenClipboardReleased);
     w.show();
     return a.exec();
 }
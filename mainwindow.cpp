@@ -1,13 +1,32 @@
 #include "mainwindow.h"
+#include "livecapture.h"
 #include <QScreen>
 #include <QGuiApplication>
 #include <QDebug>
-#include <QTimer>
-#include <QClipboard>
-#include <QApplication>
+#include <QElapsedTimer>
 #include <QThread>
+#include <QApplication>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#ifndef WDA_EXCLUDEFROMCAPTURE
+#define WDA_EXCLUDEFROMCAPTURE 0x00000011
+#endif
+#endif
+
+static const int ClearOverlayDelayMs = 50; // 透明遮罩清掉装饰后，等合成器至少刷新两帧再抓取
+
+// 让窗口不出现在屏幕抓取的结果中，实时模式的背景才不会把遮罩自己再抓进去
+static bool excludeFromCapture(QWidget *widget)
+{
+#ifdef Q_OS_WIN
+    return SetWindowDisplayAffinity(reinterpret_cast<HWND>(widget->winId()), WDA_EXCLUDEFROMCAPTURE);
+#else
+    Q_UNUSED(widget);
+    return false;
+#endif
+}
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(bool live, QImage precaptured, QWidget *parent)
     : QMainWindow(parent)
 {
     setWindowTitle("截图工具");
@@ -17,14 +36,68 @@ MainWindow::MainWindow(QWidget *parent)
 
     QScreen *screen = QGuiApplication::primaryScreen();
     if (screen) {
-        originalScreenshot = screen->grabWindow(0);
+        QElapsedTimer timer;
+        timer.start();
+        if (!precaptured.isNull()) {
+            // 预抓取的帧缓冲覆盖所有屏幕，按设备像素裁出主屏幕
+            qreal ratio = screen->devicePixelRatio();
+            QRect area(screen->geometry().topLeft() * ratio, screen->geometry().size() * ratio);
+            // 帧缓冲只有一个屏幕时不裁剪：QPixmap 直接使用这块像素（可能是共享内存），不复制。
+            // QImage 和 QPixmap 设置缩放比例前都会 detach，像素还有别的引用时就会整幅复制，
+            // 所以先把帧移进来，保证这里是唯一的引用，并在转换成 QPixmap 之前设置缩放比例
+            QImage frame = area == precaptured.rect() ? std::move(precaptured) : precaptured.copy(area);
+            precaptured = QImage();
+            frame.setDevicePixelRatio(ratio);
+            const uchar *pixels = frame.constBits();
+            const QImage::Format format = frame.format();
+            originalScreenshot = QPixmap::fromImage(std::move(frame));
+            // 格式与 QPixmap 的原生格式（不透明时为 RGB32）不同时 fromImage 会转换并复制，在日志里核对
+            const bool shared = originalScreenshot.toImage().constBits() == pixels;
+            qDebug() << "MainWindow: Pre-captured frame" << format << (shared ? "shared" : "copied")
+                     << "by QPixmap, took" << timer.elapsed() << "ms";
+        } else {
+            originalScreenshot = screen->grabWindow(0);
+            // 与常驻进程的交接耗时（main 中的 "Frame handoff" 日志）对比
+            qDebug() << "MainWindow: In-process grab" << originalScreenshot.size() << "took" << timer.elapsed() << "ms";
+        }
         screenshot = originalScreenshot;
         setGeometry(screen->geometry());
         setFixedSize(screen->geometry().size());
     }
 
+    if (screen) {
+        // 遮罩和放大镜显示之前查询，窗口树里不会有它们自己
+        windowIndex.build(screen->geometry(), screen->devicePixelRatio());
+    }
     magnifier = new MagnifierWindow(originalScreenshot, this);
-    magnifier->show();
+    if (live && screen) {
+        // 实时背景由后台线程抓取，只有允许在非界面线程中抓屏的平台才能使用
+        liveBackdrop = LiveCapture::workerGrabSupported() && excludeFromCapture(this) && excludeFromCapture(magnifier);
+        if (!liveBackdrop && !LiveCapture::translucentOverlaySupported()) {
+            // 没有合成器时透明遮罩会变成一整块黑色，退回定格模式，背景就是上面已经抓好的整屏
+            qDebug() << "MainWindow: No compositor for a translucent overlay, falling back to frozen mode";
+            live = false;
+        }
+    }
+    if (live && screen) {
+        this->live = true;
+        if (liveBackdrop) {
+            liveCapture = new LiveCapture(screen);
+            liveCapture->start();
+            liveTimer.setInterval(16);
+            connect(&liveTimer, &QTimer::timeout, this, &MainWindow::showLiveFrame);
+            liveTimer.start();
+        } else {
+            // 其它平台上无法把遮罩排除在抓取之外：遮罩保持透明，直接透出下面的实时画面，
+            // 按下鼠标时才在界面线程中抓取定格的一帧。放大镜同样会被抓进画面
+            // （再在放大镜里显示自己），所以定格之前不显示放大镜
+            setAttribute(Qt::WA_TranslucentBackground);
+        }
+        qDebug() << "MainWindow: Live mode, backdrop painted from capture:" << liveBackdrop;
+    }
+    if (magnifierAllowed()) {
+        magnifier->show();
+    }
     currentMousePos = mapFromGlobal(QCursor::pos());
     updateMagnifierPosition();
 
@@ -35,12 +108,14 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    delete liveCapture;
     delete magnifier;
     delete editWindow;
 }
 
 void MainWindow::mousePressEvent(QMouseEvent *event)
 {
+    freeze();
     if (event->button() == Qt::LeftButton && !isEditing) {
         if (isSelectingInitial) {
             startPoint = event->pos();
@@ -95,11 +170,15 @@ void MainWindow::mouseMoveEvent(QMouseEvent *event)
             default:
                 break;
             }
+            resizeEditorLive();
         }
         update();
     } else if (!isEditing) {
         updateMagnifierPosition();
-        magnifier->show();
+        if (magnifierAllowed()) {
+            magnifier->show();
+        }
+        updateHoveredWindow(event->pos(), event->modifiers());
     }
 }
 
@@ -108,6 +187,12 @@ void MainWindow::mouseReleaseEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton && (isSelectingInitial || isAdjustingSelection)) {
         if (activeHandle == None) {
             endPoint = event->pos();
+            if (isPickingWindow()) {
+                startPoint = hoveredWindow.topLeft();
+                endPoint = hoveredWindow.bottomRight();
+                qDebug() << "MainWindow: Picked window:" << hoveredWindow;
+            }
+            hoveredWindow = QRect();
         } else {
             QPoint pos = event->pos();
             switch (activeHandle) {
@@ -152,9 +237,9 @@ void MainWindow::mouseReleaseEvent(QMouseEvent *event)
         selection = selection.normalized();
         initialWidth = selection.width();
         initialHeight = selection.height();
-        QPixmap selectedPixmap = originalScreenshot.copy(selection);
         if (editWindow) {
-            editWindow->updateScreenshot(selectedPixmap, selection.topLeft());
+            editWindow->setViewport(selection);
+            editWindow->commitViewport();
             editWindow->show();
             editWindow->activateWindow();
             editWindow->setFocus();
@@ -164,22 +249,16 @@ void MainWindow::mouseReleaseEvent(QMouseEvent *event)
                 qDebug() << "MainWindow: Adjusting from edit mode completed, toolbar shown";
             }
         } else {
-            editWindow = new EditWindow(selectedPixmap, selection.topLeft(), this);
+            editWindow = new EditWindow(originalScreenshot, selection, this);
             editWindow->show();
             editWindow->activateWindow();
             editWindow->setFocus();
-            connect(editWindow, &EditWindow::finished, this, [this](const QPixmap &) {
-                for (int i = 0; i < 5; ++i) {
-                    QApplication::processEvents();
-                    QThread::msleep(50);
-                }
-                if (editWindow) {
-                    editWindow->hide();
-                    editWindow->hideToolBar();
-                }
+            connect(editWindow, &EditWindow::finished, this, [this]() {
+                // 导出在后台进行，交付完成后退出程序
+                magnifier->hide();
                 hide();
-                QCoreApplication::quit();
             });
+            connect(editWindow, &EditWindow::sessionEnded, this, &MainWindow::sessionEnded);
         }
         connect(editWindow, &EditWindow::handleDragged, this, &MainWindow::startDragging);
         connect(editWindow, &EditWindow::handleReleased, this, &MainWindow::resetSelectionState);
@@ -190,10 +269,20 @@ void MainWindow::mouseReleaseEvent(QMouseEvent *event)
 void MainWindow::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
-    painter.drawPixmap(0, 0, screenshot);
+    if (live && !liveBackdrop) {
+        // 几乎透明但不是完全透明，窗口仍然能收到鼠标事件；变暗、选框和尺寸照常画在上面
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(rect(), QColor(0, 0, 0, 1));
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        if (overlayCleared) {
+            return;
+        }
+    } else {
+        painter.drawPixmap(0, 0, screenshot);
+    }
 
     if (isSelectingInitial || isAdjustingSelection) {
-        QRect selection(startPoint, endPoint);
+        QRect selection = isPickingWindow() ? hoveredWindow : QRect(startPoint, endPoint);
         QRegion maskRegion(rect());
         maskRegion = maskRegion.subtracted(selection.normalized());
 
@@ -205,8 +294,8 @@ void MainWindow::paintEvent(QPaintEvent *event)
         painter.setPen(pen);
         painter.drawRect(selection);
 
-        int width = qAbs(endPoint.x() - startPoint.x());
-        int height = qAbs(endPoint.y() - startPoint.y());
+        int width = isPickingWindow() ? hoveredWindow.width() : qAbs(endPoint.x() - startPoint.x());
+        int height = isPickingWindow() ? hoveredWindow.height() : qAbs(endPoint.y() - startPoint.y());
         QString sizeText = QString("%1x%2").arg(width).arg(height);
 
         painter.setPen(Qt::red);
@@ -225,6 +314,66 @@ void MainWindow::paintEvent(QPaintEvent *event)
     }
 }
 
+// 界面线程取最新的完整帧，抓取线程还没写完下一帧时继续显示上一帧，不会等待
+void MainWindow::showLiveFrame()
+{
+    QImage frame;
+    if (!liveCapture || !liveCapture->takeLatest(frame)) {
+        return;
+    }
+    originalScreenshot = QPixmap::fromImage(frame);
+    screenshot = originalScreenshot;
+    magnifier->setScreenshot(originalScreenshot);
+    update();
+}
+
+// 停止实时刷新，之后的选区和编辑都基于这一帧
+void MainWindow::freeze()
+{
+    if (!live) {
+        return;
+    }
+    if (liveCapture) {
+        liveTimer.stop();
+        showLiveFrame();
+        delete liveCapture;
+        liveCapture = nullptr;
+    } else if (QScreen *screen = this->screen()) {
+        // 透明遮罩上的装饰会被抓进画面：先清掉装饰，等合成器把这一帧显示出来，再在界面线程抓取整屏
+        overlayCleared = true;
+        repaint();
+        QGuiApplication::sync();
+        QThread::msleep(ClearOverlayDelayMs);
+        originalScreenshot = screen->grabWindow(0);
+        screenshot = originalScreenshot;
+        magnifier->setScreenshot(originalScreenshot);
+        overlayCleared = false;
+    }
+    live = false;
+    update();
+    qDebug() << "MainWindow: Live capture frozen";
+}
+
+// 按住 Ctrl 时选择整个顶层窗口，否则选择鼠标下最内层的子窗口
+void MainWindow::updateHoveredWindow(const QPoint &pos, Qt::KeyboardModifiers modifiers)
+{
+    if (!isSelectingInitial) {
+        return;
+    }
+    QRect window = windowIndex.windowAt(pos, modifiers & Qt::ControlModifier);
+    if (window != hoveredWindow) {
+        hoveredWindow = window;
+        update();
+    }
+}
+
+// 还没有拖出选区时，按下和松开都以鼠标下的窗口为准
+bool MainWindow::isPickingWindow() const
+{
+    const int clickDistance = 4;
+    return isSelectingInitial && !hoveredWindow.isEmpty() && (endPoint - startPoint).manhattanLength() < clickDistance;
+}
+
 void MainWindow::updateMagnifierPosition()
 {
     QPoint globalPos = mapToGlobal(currentMousePos);
@@ -241,9 +390,7 @@ void MainWindow::updateMagnifierPosition()
 void MainWindow::startDragging(Handle handle, const QPoint &globalPos)
 {
     if (!isSelectingInitial && !isAdjustingSelection) {
-        if (editWindow) {
-            editWindow->hide();
-        }
+        // 编辑窗口不隐藏，拖动过程中随选区实时改变大小
         isEditing = false;
         isAdjustingSelection = true;
         activeHandle = handle;
@@ -306,37 +453,32 @@ void MainWindow::startDragging(Handle handle, const QPoint &globalPos)
     default:
         break;
     }
+    resizeEditorLive();
     update();
     qDebug() << "MainWindow: Dragging handle:" << activeHandle << ", startPoint:" << startPoint << ", endPoint:" << endPoint;
 }
 
-QPixmap MainWindow::updateSelectionPosition(const QPoint &newPos)
+// 拖动手柄时每次移动都把新选区交给编辑窗口，图层由它的缓冲池复用，不会每次重新分配
+void MainWindow::resizeEditorLive()
 {
-    startPoint = newPos;
-    endPoint = startPoint + QPoint(initialWidth, initialHeight);
+    QRect selection = QRect(startPoint, endPoint).normalized();
+    if (editWindow && isAdjustingSelection && !selection.isEmpty()) {
+        editWindow->setViewport(selection);
+    }
+}
 
+QRect MainWindow::updateSelectionPosition(const QPoint &newPos)
+{
+    // 拖动只平移选区，不再裁剪截图，像素由 EditWindow 的视口直接引用
     QRect screenRect = screen()->geometry();
-    if (startPoint.x() < 0) {
-        startPoint.setX(0);
-        endPoint.setX(initialWidth);
-    }
-    if (startPoint.y() < 0) {
-        startPoint.setY(0);
-        endPoint.setY(initialHeight);
-    }
-    if (endPoint.x() > screenRect.width()) {
-        endPoint.setX(screenRect.width());
-        startPoint.setX(screenRect.width() - initialWidth);
-    }
-    if (endPoint.y() > screenRect.height()) {
-        endPoint.setY(screenRect.height());
-        startPoint.setY(screenRect.height() - initialHeight);
-    }
+    QRect newSelection(newPos, QSize(initialWidth, initialHeight));
+    newSelection.moveLeft(qBound(0, newSelection.left(), screenRect.width() - initialWidth));
+    newSelection.moveTop(qBound(0, newSelection.top(), screenRect.height() - initialHeight));
 
-    QRect newSelection(startPoint, endPoint);
-    QPixmap newScreenshot = originalScreenshot.copy(newSelection);
-    qDebug() << "MainWindow: New selection size:" << newSelection.width() << "x" << newSelection.height();
-    return newScreenshot;
+    startPoint = newSelection.topLeft();
+    endPoint = newSelection.bottomRight();
+    qDebug() << "MainWindow: New selection:" << newSelection;
+    return newSelection;
 }
 
 QRect MainWindow::getSelection() const
@@ -355,8 +497,10 @@ void MainWindow::resetSelectionState()
         editWindow->setMode(-1);
         QRect selection(startPoint, endPoint);
         selection = selection.normalized();
-        QPixmap newScreenshot = originalScreenshot.copy(selection);
-        editWindow->updateScreenshot(newScreenshot, selection.topLeft());
+        initialWidth = selection.width();
+        initialHeight = selection.height();
+        editWindow->setViewport(selection);
+        editWindow->commitViewport();
         editWindow->show();
         editWindow->activateWindow();
         editWindow->setFocus();
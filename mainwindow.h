@@ -5,22 +5,30 @@
 #include <QPixmap>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QTimer>
 #include "magnifierwindow.h"
 #include "editwindow.h"
 #include "common.h"
+#include "windowindex.h"
+
+class LiveCapture;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    // live 为 true 时背景持续刷新，按下鼠标才定格；precaptured 是常驻进程预先抓好的整个根窗口，为空时现场抓取
+    MainWindow(bool live = false, QImage precaptured = QImage(), QWidget *parent = nullptr);
     ~MainWindow();
-    QPixmap updateSelectionPosition(const QPoint &newPos);
+    QRect updateSelectionPosition(const QPoint &newPos);
     QRect getSelection() const;
     void resetSelectionState();
     bool isSelectingInitialState() const;
     bool isAdjustingSelectionState() const;
 
+signals:
+    void sessionEnded(); // 编辑器导出完成、失败或取消
+
 protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
@@ -44,9 +52,23 @@ private:
     QPoint dragStartPos;
     int initialWidth = 0;
     int initialHeight = 0;
+    bool live = false;                // 实时模式，还没有定格
+    LiveCapture *liveCapture = nullptr; // 只在实时画面画成背景时使用
+    QTimer liveTimer;
+    WindowIndex windowIndex;   // 截图时查询一次的窗口几何，悬停时只查本地索引
+    QRect hoveredWindow;       // 鼠标下的窗口，单击（不拖动）时选中它
+    bool liveBackdrop = false; // 遮罩不会被抓进画面时才能把实时画面画成背景，否则遮罩保持透明
+    bool overlayCleared = false; // 透明遮罩定格前暂时不画装饰，避免被抓进定格的画面
 
     void updateMagnifierPosition();
+    void showLiveFrame();
+    void freeze();
+    // 放大镜会被实时抓取拍进画面时，定格之前不显示
+    bool magnifierAllowed() const { return !live || liveBackdrop; }
+    void updateHoveredWindow(const QPoint &pos, Qt::KeyboardModifiers modifiers);
+    bool isPickingWindow() const;
     void startDragging(Handle handle, const QPoint &globalPos);
+    void resizeEditorLive();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,201 @@
+#include "patchfinder.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const int BandRows = 32;
+static const int MaxPatchSide = 256; // 更大的模板只取中心部分做匹配，同时保证窗口平方和不超过 32 位
+static const int MaxMatches = 1000;
+static const int MaxCandidates = 100000; // 抑制前最多保留的候选数，按差值从小到大取
+static const double MinPatchStd = 3.0;   // 灰度标准差低于此值的模板（纯色、平滑渐变）到处都能匹配，直接拒绝
+
+struct PatchMatch {
+    QPoint pos;
+    quint64 sad;
+};
+
+// 灰度转换是逐像素的整数运算，编译器可以向量化
+static QVector<uchar> toGray(const QImage &source, int &width, int &height)
+{
+    QImage image = source.convertToFormat(QImage::Format_RGB32);
+    width = image.width();
+    height = image.height();
+    QVector<uchar> gray(width * height);
+    for (int y = 0; y < height; ++y) {
+        const quint32 *row = reinterpret_cast<const quint32 *>(image.constScanLine(y));
+        uchar *out = gray.data() + y * width;
+        for (int x = 0; x < width; ++x) {
+            quint32 p = row[x];
+            out[x] = uchar((((p >> 16) & 0xff) * 77 + ((p >> 8) & 0xff) * 150 + (p & 0xff) * 29) >> 8);
+        }
+    }
+    return gray;
+}
+
+PatchFinder::PatchFinder(int maxMeanDifference)
+    : maxMeanDifference(maxMeanDifference)
+{
+}
+
+QList<QRect> PatchFinder::findAll(const QImage &image, const QRect &selected) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    int width, height;
+    const QVector<uchar> gray = toGray(image, width, height);
+    QRect patch = selected & QRect(0, 0, width, height);
+    if (patch.width() < 4 || patch.height() < 4) {
+        return {};
+    }
+    // 只用中心部分匹配，返回时再扩展回完整选区
+    QRect core = patch;
+    if (core.width() > MaxPatchSide) {
+        core.setLeft(patch.left() + (patch.width() - MaxPatchSide) / 2);
+        core.setWidth(MaxPatchSide);
+    }
+    if (core.height() > MaxPatchSide) {
+        core.setTop(patch.top() + (patch.height() - MaxPatchSide) / 2);
+        core.setHeight(MaxPatchSide);
+    }
+    const int pw = core.width();
+    const int ph = core.height();
+    const int area = pw * ph;
+
+    // 积分图多一行一列，(x, y) 处为左上角 x*y 区域之和。
+    // 用 32 位无符号数按模累加：窗口不超过 256x256 时真实的窗口和小于 2^32，差分结果仍然正确
+    const int iw = width + 1;
+    QVector<quint32> sum(qint64(iw) * (height + 1), 0);
+    QVector<quint32> sumSq(qint64(iw) * (height + 1), 0);
+    for (int y = 0; y < height; ++y) {
+        const uchar *row = gray.constData() + y * width;
+        quint32 rowSum = 0;
+        quint32 rowSumSq = 0;
+        for (int x = 0; x < width; ++x) {
+            rowSum += row[x];
+            rowSumSq += quint32(row[x]) * row[x];
+            sum[(y + 1) * iw + x + 1] = sum[y * iw + x + 1] + rowSum;
+            sumSq[(y + 1) * iw + x + 1] = sumSq[y * iw + x + 1] + rowSumSq;
+        }
+    }
+    auto boxSum = [iw](const QVector<quint32> &table, int x, int y, int w, int h) {
+        return quint32(table[(y + h) * iw + x + w] - table[y * iw + x + w] - table[(y + h) * iw + x] + table[y * iw + x]);
+    };
+
+    QVector<uchar> templ(area);
+    for (int y = 0; y < ph; ++y) {
+        memcpy(templ.data() + y * pw, gray.constData() + (core.top() + y) * width + core.left(), pw);
+    }
+    const double templMean = double(boxSum(sum, core.left(), core.top(), pw, ph)) / area;
+    const double templStd = std::sqrt(qMax(0.0, double(boxSum(sumSq, core.left(), core.top(), pw, ph)) / area - templMean * templMean));
+    if (templStd < MinPatchStd) {
+        qDebug() << "PatchFinder: Patch" << patch << "is too flat to search, std:" << templStd;
+        return {};
+    }
+
+    // 均值差至多为平均绝对差；标准差用宽松的比例，只剔除明显不同的窗口（例如纯色背景）
+    const quint64 maxSad = quint64(maxMeanDifference) * area;
+    const double maxMeanDelta = maxMeanDifference;
+    const double minStd = templStd * 0.5 - maxMeanDifference;
+    const double maxStd = templStd * 1.5 + maxMeanDifference;
+
+    QList<int> bands;
+    for (int y = 0; y + ph <= height; y += BandRows) {
+        bands.append(y);
+    }
+    const int lastY = height - ph;
+    const int lastX = width - pw;
+    const uchar *grayData = gray.constData();
+    const uchar *templData = templ.constData();
+    QList<QVector<PatchMatch>> bandMatches = QtConcurrent::blockingMapped(bands, [&](int firstY) {
+        QVector<PatchMatch> matches;
+        for (int y = firstY; y < qMin(firstY + BandRows, lastY + 1); ++y) {
+            for (int x = 0; x <= lastX; ++x) {
+                double mean = double(boxSum(sum, x, y, pw, ph)) / area;
+                if (std::abs(mean - templMean) > maxMeanDelta) {
+                    continue;
+                }
+                double variance = double(boxSum(sumSq, x, y, pw, ph)) / area - mean * mean;
+                double std = std::sqrt(qMax(0.0, variance));
+                if (std < minStd || std > maxStd) {
+                    continue;
+                }
+                // 逐行累加绝对差，行内循环可以向量化；超过阈值提前退出
+                quint64 sad = 0;
+                for (int row = 0; row < ph && sad <= maxSad; ++row) {
+                    const uchar *a = grayData + (y + row) * width + x;
+                    const uchar *b = templData + row * pw;
+                    quint32 rowSad = 0;
+                    for (int i = 0; i < pw; ++i) {
+                        rowSad += quint32(qAbs(int(a[i]) - int(b[i])));
+                    }
+                    sad += rowSad;
+                }
+                if (sad > maxSad) {
+                    continue;
+                }
+                // 同一行上相互重叠的连续命中只保留差值最小的一个，抑制之前候选数就不会随模板宽度成倍增长
+                if (!matches.isEmpty() && matches.last().pos.y() == y && x - matches.last().pos.x() < pw) {
+                    if (sad < matches.last().sad) {
+                        matches.last() = {QPoint(x, y), sad};
+                    }
+                    continue;
+                }
+                matches.append({QPoint(x, y), sad});
+            }
+        }
+        return matches;
+    });
+
+    QVector<PatchMatch> candidates;
+    for (const QVector<PatchMatch> &matches : bandMatches) {
+        candidates += matches;
+    }
+    auto better = [](const PatchMatch &a, const PatchMatch &b) {
+        return a.sad < b.sad;
+    };
+    if (candidates.size() > MaxCandidates) {
+        std::partial_sort(candidates.begin(), candidates.begin() + MaxCandidates, candidates.end(), better);
+        candidates.resize(MaxCandidates);
+    } else {
+        std::sort(candidates.begin(), candidates.end(), better);
+    }
+
+    // 非极大值抑制：与已接受的匹配重叠的候选都丢弃。
+    // 已接受的匹配按模板大小的格子登记，重叠的匹配只可能在相邻的 3x3 个格子里，每个候选的检查是常数时间
+    QList<QRect> result;
+    const QPoint coreOffset = core.topLeft() - patch.topLeft();
+    const int cellW = patch.width();
+    const int cellH = patch.height();
+    const int gridColumns = width / cellW + 3;
+    const int gridRows = height / cellH + 3;
+    QVector<QVector<QRect>> grid(gridColumns * gridRows);
+    for (const PatchMatch &match : std::as_const(candidates)) {
+        QRect rect(match.pos - coreOffset, patch.size());
+        // 匹配位置减去偏移后至多向左上越界一个模板，整体加一格保证格子坐标非负
+        const int gx = (rect.x() + cellW) / cellW;
+        const int gy = (rect.y() + cellH) / cellH;
+        bool overlaps = false;
+        for (int cy = qMax(0, gy - 1); cy <= qMin(gridRows - 1, gy + 1) && !overlaps; ++cy) {
+            for (int cx = qMax(0, gx - 1); cx <= qMin(gridColumns - 1, gx + 1) && !overlaps; ++cx) {
+                const QVector<QRect> &cell = grid[cy * gridColumns + cx];
+                overlaps = std::any_of(cell.begin(), cell.end(), [&rect](const QRect &accepted) {
+                    return accepted.intersects(rect);
+                });
+            }
+        }
+        if (!overlaps) {
+            grid[gy * gridColumns + gx].append(rect);
+            result.append(rect & QRect(0, 0, width, height));
+            if (result.size() >= MaxMatches) {
+                break;
+            }
+        }
+    }
+    qDebug() << "PatchFinder: Patch" << patch << ", candidates:" << candidates.size() << ", matches:" << result.size()
+             << ", time:" << timer.elapsed() << "ms";
+    return result;
+}
@@ -0,0 +1,24 @@
+#ifndef PATCHFINDER_H
+#define PATCHFINDER_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+
+// 在截图中查找与选中区域相同的所有位置（如重复出现的用户名、头像）。
+// 先转成灰度并建立和/平方和积分图，每个候选窗口用 O(1) 的均值和方差与模板比较作为预筛选；
+// 通过预筛选的窗口再逐行累加灰度绝对差，超过阈值立即放弃。
+// 行带在线程池中并行处理，最后做非极大值抑制，重叠的匹配只保留差值最小的一个。
+// 纹理太少的模板（纯色背景）会在几乎每个位置命中，直接拒绝；耗时与截图大小成正比，调用方应在后台线程调用。
+class PatchFinder {
+public:
+    explicit PatchFinder(int maxMeanDifference = 10);
+
+    // patch 是 image 中的一个矩形，返回的矩形包含 patch 本身
+    QList<QRect> findAll(const QImage &image, const QRect &patch) const;
+
+private:
+    int maxMeanDifference; // 每像素允许的平均灰度差
+};
+
+#endif // PATCHFINDER_H
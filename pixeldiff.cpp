@@ -0,0 +1,134 @@
+#include "pixeldiff.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QHash>
+#include <QDebug>
+#include <numeric>
+#include <algorithm>
+
+static const int BandCells = 8; // 每个行带包含的格子行数
+
+PixelDiff::PixelDiff(int tolerance, int cellSize)
+    : tolerance(tolerance), cellSize(qMax(1, cellSize))
+{
+}
+
+static int findRoot(QVector<int> &parent, int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// 一行中的一个格子宽度范围内是否有像素超出容差。无分支的逐像素运算，编译器可以向量化
+static bool spanChanged(const quint32 *a, const quint32 *b, int count, int tolerance)
+{
+    int worst = 0;
+    for (int x = 0; x < count; ++x) {
+        quint32 p = a[x];
+        quint32 q = b[x];
+        int dr = qAbs(int((p >> 16) & 0xff) - int((q >> 16) & 0xff));
+        int dg = qAbs(int((p >> 8) & 0xff) - int((q >> 8) & 0xff));
+        int db = qAbs(int(p & 0xff) - int(q & 0xff));
+        worst = qMax(worst, qMax(dr, qMax(dg, db)));
+    }
+    return worst > tolerance;
+}
+
+QList<QRect> PixelDiff::changedRegions(const QImage &before, const QImage &after) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    const int width = qMin(before.width(), after.width());
+    const int height = qMin(before.height(), after.height());
+    if (width <= 0 || height <= 0) {
+        return {};
+    }
+    QImage a = before.convertToFormat(QImage::Format_RGB32);
+    QImage b = after.convertToFormat(QImage::Format_RGB32);
+
+    const int cellsX = (width + cellSize - 1) / cellSize;
+    const int cellsY = (height + cellSize - 1) / cellSize;
+    QVector<uchar> changed(cellsX * cellsY, 0);
+
+    // 行带按整格对齐，不同行带写入不同的格子行，互不冲突
+    QList<int> bands;
+    for (int cellY = 0; cellY < cellsY; cellY += BandCells) {
+        bands.append(cellY);
+    }
+    const int tol = tolerance;
+    const int cell = cellSize;
+    uchar *cells = changed.data();
+    QtConcurrent::blockingMap(bands, [&a, &b, cells, width, height, cellsX, cellsY, tol, cell](int firstCellY) {
+        int lastCellY = qMin(firstCellY + BandCells, cellsY);
+        for (int y = firstCellY * cell; y < qMin(lastCellY * cell, height); ++y) {
+            const quint32 *rowA = reinterpret_cast<const quint32 *>(a.constScanLine(y));
+            const quint32 *rowB = reinterpret_cast<const quint32 *>(b.constScanLine(y));
+            uchar *cellRow = cells + (y / cell) * cellsX;
+            for (int cellX = 0; cellX < cellsX; ++cellX) {
+                if (cellRow[cellX]) {
+                    continue;
+                }
+                int x = cellX * cell;
+                cellRow[cellX] = spanChanged(rowA + x, rowB + x, qMin(cell, width - x), tol);
+            }
+        }
+    });
+    qint64 compareMs = timer.elapsed();
+
+    // 并查集合并 8 邻接的已变化格子
+    QVector<int> parent(cellsX * cellsY);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto unite = [&parent](int i, int j) {
+        int ri = findRoot(parent, i);
+        int rj = findRoot(parent, j);
+        if (ri != rj) {
+            parent[qMax(ri, rj)] = qMin(ri, rj);
+        }
+    };
+    for (int y = 0; y < cellsY; ++y) {
+        for (int x = 0; x < cellsX; ++x) {
+            int i = y * cellsX + x;
+            if (!changed[i]) {
+                continue;
+            }
+            if (x > 0 && changed[i - 1]) {
+                unite(i, i - 1);
+            }
+            if (y > 0) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = x + dx;
+                    if (nx >= 0 && nx < cellsX && changed[i - cellsX + dx]) {
+                        unite(i, i - cellsX + dx);
+                    }
+                }
+            }
+        }
+    }
+
+    QHash<int, QRect> regions;
+    for (int y = 0; y < cellsY; ++y) {
+        for (int x = 0; x < cellsX; ++x) {
+            int i = y * cellsX + x;
+            if (!changed[i]) {
+                continue;
+            }
+            QRect rect(x * cellSize, y * cellSize, cellSize, cellSize);
+            QRect &region = regions[findRoot(parent, i)];
+            region = region.isNull() ? rect : region.united(rect);
+        }
+    }
+    QList<QRect> result;
+    for (const QRect &region : std::as_const(regions)) {
+        result.append(region & QRect(0, 0, width, height));
+    }
+    std::sort(result.begin(), result.end(), [](const QRect &l, const QRect &r) {
+        return l.top() != r.top() ? l.top() < r.top() : l.left() < r.left();
+    });
+    qDebug() << "PixelDiff:" << width << "x" << height << ", regions:" << result.size()
+             << ", compare:" << compareMs << "ms, total:" << timer.elapsed() << "ms";
+    return result;
+}
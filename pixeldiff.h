@@ -0,0 +1,23 @@
+#ifndef PIXELDIFF_H
+#define PIXELDIFF_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+
+// 两张截图的逐像素比较，返回发生变化的区域。
+// 图像按行带分给线程池并行比较，任一通道差值超过容差的像素把所在的格子标记为已变化；
+// 再用并查集把相邻（含对角）的已变化格子合并成连通区域，输出各区域的外接矩形。
+class PixelDiff {
+public:
+    explicit PixelDiff(int tolerance = 24, int cellSize = 8);
+
+    // 只比较两张图重叠的左上部分，矩形坐标基于图像本身
+    QList<QRect> changedRegions(const QImage &before, const QImage &after) const;
+
+private:
+    int tolerance;
+    int cellSize;
+};
+
+#endif // PIXELDIFF_H
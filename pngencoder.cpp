@@ -0,0 +1,438 @@
+#include "pngencoder.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QThread>
+#include <QBuffer>
+#include <QVector>
+#include <QList>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QImageWriter>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <cstdlib>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+
+// 一个行带：先并行过滤，再以前一块末尾 32KB 作为字典并行压缩
+struct PngChunk {
+    int index = 0;
+    int firstRow = 0;
+    int rowCount = 0;
+    QByteArray filtered;   // 每行：1 字节过滤类型 + 像素数据
+    QByteArray compressed; // 原始 deflate 数据，非最后一块以 Z_SYNC_FLUSH 结束
+    uLong adler = 1;
+};
+
+static const int DictionarySize = 32768;
+static const int MinChunkBytes = 256 * 1024; // 每块至少约 256KB 原始数据，避免压缩率明显下降
+
+static void appendUInt32(QByteArray &data, quint32 value)
+{
+    data.append(char((value >> 24) & 0xFF));
+    data.append(char((value >> 16) & 0xFF));
+    data.append(char((value >> 8) & 0xFF));
+    data.append(char(value & 0xFF));
+}
+
+static bool writeChunk(QIODevice *device, const char *type, const QList<QByteArray> &parts)
+{
+    quint32 length = 0;
+    for (const QByteArray &part : parts) {
+        length += quint32(part.size());
+    }
+    QByteArray header;
+    appendUInt32(header, length);
+    header.append(type, 4);
+
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef *>(type), 4);
+    bool ok = device->write(header) == header.size();
+    for (const QByteArray &part : parts) {
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(part.constData()), uInt(part.size()));
+        ok = ok && device->write(part) == part.size();
+    }
+    QByteArray trailer;
+    appendUInt32(trailer, quint32(crc));
+    return ok && device->write(trailer) == trailer.size();
+}
+
+static void filterRow(int type, const uchar *row, const uchar *prev, int rowBytes, int bpp, uchar *out)
+{
+    switch (type) {
+    case 0: // None
+        memcpy(out, row, rowBytes);
+        break;
+    case 1: // Sub
+        for (int i = 0; i < bpp; ++i) out[i] = row[i];
+        for (int i = bpp; i < rowBytes; ++i) out[i] = uchar(row[i] - row[i - bpp]);
+        break;
+    case 2: // Up
+        for (int i = 0; i < rowBytes; ++i) out[i] = uchar(row[i] - prev[i]);
+        break;
+    case 3: // Average
+        for (int i = 0; i < bpp; ++i) out[i] = uchar(row[i] - (prev[i] >> 1));
+        for (int i = bpp; i < rowBytes; ++i) out[i] = uchar(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+        break;
+    case 4: // Paeth，行首左侧和左上都视为 0，预测值退化为上方像素
+        for (int i = 0; i < bpp; ++i) out[i] = uchar(row[i] - prev[i]);
+        for (int i = bpp; i < rowBytes; ++i) {
+            int a = row[i - bpp];
+            int b = prev[i];
+            int c = prev[i - bpp];
+            int pa = std::abs(b - c);
+            int pb = std::abs(a - c);
+            int pc = std::abs(a + b - 2 * c);
+            int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            out[i] = uchar(row[i] - predictor);
+        }
+        break;
+    }
+}
+
+static quint64 filterCost(const uchar *data, int size)
+{
+    quint64 sum = 0;
+    for (int i = 0; i < size; ++i) {
+        sum += uchar(std::abs(int(static_cast<signed char>(data[i]))));
+    }
+    return sum;
+}
+
+// 位深小于 8 的索引色：每字节放多个像素，高位在前
+static QByteArray packRows(const QImage &source, int bitDepth, int rowBytes)
+{
+    QByteArray packed(source.height() * rowBytes, 0);
+    int pixelsPerByte = 8 / bitDepth;
+    for (int y = 0; y < source.height(); ++y) {
+        const uchar *row = source.constScanLine(y);
+        uchar *out = reinterpret_cast<uchar *>(packed.data()) + qsizetype(y) * rowBytes;
+        for (int x = 0; x < source.width(); ++x) {
+            int shift = 8 - bitDepth * (x % pixelsPerByte + 1);
+            out[x / pixelsPerByte] |= uchar(row[x] << shift);
+        }
+    }
+    return packed;
+}
+
+static void filterChunk(PngChunk &chunk, const QImage &image, QImage::Format format, int bpp, int bitDepth,
+                        int rowBytes, int fixedFilter)
+{
+    // 连同上一行一起转换成 PNG 的字节顺序，Up/Average/Paeth 需要它
+    int top = qMax(0, chunk.firstRow - 1);
+    int rows = chunk.firstRow + chunk.rowCount - top;
+    QImage view(image.constScanLine(top), image.width(), rows, image.bytesPerLine(), image.format());
+    if (image.format() == QImage::Format_Indexed8) {
+        view.setColorTable(image.colorTable());
+    }
+    QImage source = view.format() == format ? view : view.convertToFormat(format);
+    QByteArray packed;
+    if (bitDepth < 8) {
+        packed = packRows(source, bitDepth, rowBytes);
+    }
+    auto sourceRow = [&source, &packed, bitDepth, rowBytes](int y) {
+        return bitDepth < 8 ? reinterpret_cast<const uchar *>(packed.constData()) + qsizetype(y) * rowBytes
+                            : source.constScanLine(y);
+    };
+
+    chunk.filtered.resize(chunk.rowCount * (rowBytes + 1));
+    uchar *out = reinterpret_cast<uchar *>(chunk.filtered.data());
+
+    QByteArray zeroRow(rowBytes, 0);
+    QByteArray candidate(rowBytes, 0);
+    QByteArray best(rowBytes, 0);
+    for (int i = 0; i < chunk.rowCount; ++i) {
+        int y = chunk.firstRow + i;
+        const uchar *row = sourceRow(y - top);
+        const uchar *prev = y > 0 ? sourceRow(y - 1 - top) : reinterpret_cast<const uchar *>(zeroRow.constData());
+        uchar *dst = out + qsizetype(i) * (rowBytes + 1);
+
+        if (fixedFilter >= 0) {
+            dst[0] = uchar(fixedFilter);
+            filterRow(fixedFilter, row, prev, rowBytes, bpp, dst + 1);
+            continue;
+        }
+
+        // 自适应过滤：取绝对值之和最小的过滤类型
+        int bestType = 0;
+        quint64 bestCost = ~quint64(0);
+        uchar *candidateData = reinterpret_cast<uchar *>(candidate.data());
+        uchar *bestData = reinterpret_cast<uchar *>(best.data());
+        for (int type = 0; type < 5; ++type) {
+            filterRow(type, row, prev, rowBytes, bpp, candidateData);
+            quint64 cost = filterCost(candidateData, rowBytes);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestType = type;
+                std::swap(candidateData, bestData);
+            }
+        }
+        dst[0] = uchar(bestType);
+        memcpy(dst + 1, bestData, rowBytes);
+    }
+
+    chunk.adler = adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef *>(chunk.filtered.constData()), uInt(chunk.filtered.size()));
+}
+
+static void compressChunk(PngChunk &chunk, const PngChunk *previous, int level, int strategy, bool last)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy) != Z_OK) {
+        return;
+    }
+    if (previous) {
+        int dictionarySize = qMin(DictionarySize, int(previous->filtered.size()));
+        const char *dictionary = previous->filtered.constData() + previous->filtered.size() - dictionarySize;
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary), uInt(dictionarySize));
+    }
+
+    stream.next_in = reinterpret_cast<Bytef *>(chunk.filtered.data());
+    stream.avail_in = uInt(chunk.filtered.size());
+    chunk.compressed.reserve(int(deflateBound(&stream, stream.avail_in)) + 16);
+
+    // 非最后一块以同步刷新结束（字节对齐、不置 BFINAL），拼接后仍是一个合法的 deflate 流
+    int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    char buffer[65536];
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        if (deflate(&stream, flush) == Z_STREAM_ERROR) {
+            break;
+        }
+        chunk.compressed.append(buffer, int(sizeof(buffer) - stream.avail_out));
+    } while (stream.avail_out == 0);
+    deflateEnd(&stream);
+}
+
+// 由图像格式决定的 PNG 像素布局
+struct PngFormat {
+    bool indexed = false;
+    int bitDepth = 8;
+    QImage::Format format = QImage::Format_RGB888;
+    int bpp = 3;
+    quint8 colorType = 2;
+    int rowBytes = 0;
+};
+
+static PngFormat formatFor(const QImage &image)
+{
+    // Indexed8 且颜色表不超过 256 项时写索引色 PNG，颜色少时进一步降低位深
+    PngFormat f;
+    f.indexed = image.format() == QImage::Format_Indexed8 && image.colorCount() > 0 && image.colorCount() <= 256;
+    bool alpha = !f.indexed && image.hasAlphaChannel();
+    if (f.indexed) {
+        int colors = image.colorCount();
+        f.bitDepth = colors <= 2 ? 1 : (colors <= 4 ? 2 : (colors <= 16 ? 4 : 8));
+    }
+    f.format = f.indexed ? QImage::Format_Indexed8 : (alpha ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+    f.bpp = f.indexed ? 1 : (alpha ? 4 : 3);
+    f.colorType = f.indexed ? 3 : (alpha ? 6 : 2);
+    f.rowBytes = f.indexed ? (image.width() * f.bitDepth + 7) / 8 : image.width() * f.bpp;
+    return f;
+}
+
+// 并行过滤和压缩全部行带；失败时返回空列表
+static QVector<PngChunk> compressImage(const QImage &image, const PngFormat &f, PngEncoder::Preset preset, uLong &adler)
+{
+    int level = preset == PngEncoder::Fastest ? 1 : (preset == PngEncoder::Balanced ? 6 : 9);
+    int strategy = preset == PngEncoder::Fastest || f.indexed ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+    // 索引色按 PNG 规范的建议不做过滤；最快档固定使用 Sub；其余逐行自适应
+    int fixedFilter = f.indexed ? 0 : (preset == PngEncoder::Fastest ? 1 : -1);
+
+    // 切块：块数约为核心数的两倍，但每块不能太小
+    int threads = qMax(1, QThread::idealThreadCount());
+    int minRows = qMax(1, MinChunkBytes / (f.rowBytes + 1));
+    int rowsPerChunk = qMax(minRows, (image.height() + threads * 2 - 1) / (threads * 2));
+
+    QVector<PngChunk> chunks;
+    for (int y = 0; y < image.height(); y += rowsPerChunk) {
+        PngChunk chunk;
+        chunk.index = chunks.size();
+        chunk.firstRow = y;
+        chunk.rowCount = qMin(rowsPerChunk, image.height() - y);
+        chunks.append(chunk);
+    }
+
+    QtConcurrent::blockingMap(chunks, [&image, &f, fixedFilter](PngChunk &chunk) {
+        filterChunk(chunk, image, f.format, f.bpp, f.bitDepth, f.rowBytes, fixedFilter);
+    });
+    const PngChunk *first = chunks.constData();
+    int chunkCount = chunks.size();
+    QtConcurrent::blockingMap(chunks, [first, chunkCount, level, strategy](PngChunk &chunk) {
+        const PngChunk *previous = chunk.index > 0 ? first + chunk.index - 1 : nullptr;
+        compressChunk(chunk, previous, level, strategy, chunk.index == chunkCount - 1);
+    });
+
+    adler = adler32(0L, Z_NULL, 0);
+    for (const PngChunk &chunk : chunks) {
+        if (chunk.compressed.isEmpty()) {
+            qDebug() << "PngEncoder: Compression failed for chunk" << chunk.index;
+            return {};
+        }
+        adler = adler32_combine(adler, chunk.adler, z_off_t(chunk.filtered.size()));
+    }
+    return chunks;
+}
+
+// zlib 头的 FLEVEL 与压缩级别对应，满足 (CMF * 256 + FLG) % 31 == 0
+static QByteArray zlibHeader(PngEncoder::Preset preset)
+{
+    static const char zlibFastest[] = {0x78, 0x01};
+    static const char zlibDefault[] = {0x78, char(0x9C)};
+    static const char zlibBest[] = {0x78, char(0xDA)};
+    return QByteArray(preset == PngEncoder::Fastest ? zlibFastest : (preset == PngEncoder::Balanced ? zlibDefault : zlibBest), 2);
+}
+#endif // HAVE_ZLIB
+
+PngEncoder::PngEncoder(Preset preset)
+    : preset(preset)
+{
+}
+
+QString PngEncoder::presetName(Preset preset)
+{
+    switch (preset) {
+    case Fastest: return "fastest";
+    case Balanced: return "balanced";
+    case Smallest: return "smallest";
+    }
+    return QString();
+}
+
+QByteArray PngEncoder::encode(const QImage &image) const
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!write(image, &buffer)) {
+        data.clear();
+    }
+    return data;
+}
+
+#ifdef HAVE_ZLIB
+QByteArray PngEncoder::imageData(const QImage &image) const
+{
+    if (image.isNull()) {
+        return QByteArray();
+    }
+    uLong adler = 1;
+    QVector<PngChunk> chunks = compressImage(image, formatFor(image), preset, adler);
+    if (chunks.isEmpty()) {
+        return QByteArray();
+    }
+    QByteArray data = zlibHeader(preset);
+    for (const PngChunk &chunk : std::as_const(chunks)) {
+        data.append(chunk.compressed);
+    }
+    appendUInt32(data, quint32(adler));
+    return data;
+}
+
+bool PngEncoder::write(const QImage &image, QIODevice *device) const
+{
+    if (image.isNull() || !device) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    const PngFormat f = formatFor(image);
+    const bool indexed = f.indexed;
+    const int bitDepth = f.bitDepth;
+    const int threads = qMax(1, QThread::idealThreadCount());
+    uLong adler = 1;
+    QVector<PngChunk> chunks = compressImage(image, f, preset, adler);
+    if (chunks.isEmpty()) {
+        return false;
+    }
+    const int chunkCount = chunks.size();
+
+    device->write("\x89PNG\r\n\x1a\n", 8);
+
+    QByteArray header;
+    appendUInt32(header, quint32(image.width()));
+    appendUInt32(header, quint32(image.height()));
+    header.append(char(bitDepth));   // 位深
+    header.append(char(f.colorType)); // 颜色类型
+    header.append(char(0));          // 压缩方法
+    header.append(char(0));          // 过滤方法
+    header.append(char(0));          // 不隔行
+    bool ok = writeChunk(device, "IHDR", {header});
+
+    if (indexed) {
+        // 调色板，以及截止到最后一个非不透明颜色的透明度表
+        QByteArray palette;
+        QByteArray transparency;
+        int lastTranslucent = -1;
+        const QVector<QRgb> colors = image.colorTable();
+        for (int i = 0; i < colors.size(); ++i) {
+            palette.append(char(qRed(colors[i])));
+            palette.append(char(qGreen(colors[i])));
+            palette.append(char(qBlue(colors[i])));
+            transparency.append(char(qAlpha(colors[i])));
+            if (qAlpha(colors[i]) != 255) {
+                lastTranslucent = i;
+            }
+        }
+        ok = ok && writeChunk(device, "PLTE", {palette});
+        if (lastTranslucent >= 0) {
+            ok = ok && writeChunk(device, "tRNS", {transparency.left(lastTranslucent + 1)});
+        }
+    }
+
+    for (const PngChunk &chunk : chunks) {
+        QList<QByteArray> parts;
+        if (chunk.index == 0) {
+            parts.append(zlibHeader(preset));
+        }
+        parts.append(chunk.compressed);
+        if (chunk.index == chunkCount - 1) {
+            QByteArray trailer;
+            appendUInt32(trailer, quint32(adler));
+            parts.append(trailer);
+        }
+        ok = ok && writeChunk(device, "IDAT", parts);
+    }
+    ok = ok && writeChunk(device, "IEND", {});
+
+    qDebug() << "PngEncoder: Encoded" << image.size() << "preset:" << presetName(preset)
+             << (indexed ? QString("indexed %1-bit").arg(bitDepth) : QString("truecolor"))
+             << ", chunks:" << chunkCount << ", threads:" << threads
+             << ", time:" << timer.elapsed() << "ms, ok:" << ok;
+    return ok;
+}
+#else
+// 没有 zlib 时没有内置编码器：IDAT 数据流无法单独生成，PNG 交给 Qt 的图像插件编码。
+// QImageWriter 的 quality 0~100 对应 zlib 9~0 级，按三档预设的压缩级别换算
+QByteArray PngEncoder::imageData(const QImage &image) const
+{
+    Q_UNUSED(image);
+    return QByteArray();
+}
+
+bool PngEncoder::write(const QImage &image, QIODevice *device) const
+{
+    if (image.isNull() || !device) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QImageWriter writer(device, "png");
+    writer.setQuality(preset == Fastest ? 89 : (preset == Balanced ? 34 : 0));
+    bool ok = writer.write(image);
+    qDebug() << "PngEncoder: Encoded" << image.size() << "with QImageWriter, preset:" << presetName(preset)
+             << ", time:" << timer.elapsed() << "ms, ok:" << ok;
+    return ok;
+}
+#endif // HAVE_ZLIB
+
+bool PngEncoder::isBuiltin()
+{
+#ifdef HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
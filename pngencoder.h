@@ -0,0 +1,35 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+// 内置的 PNG 编码器：按行带切块，过滤和 deflate 在各个 CPU 核心上并行执行，
+// 各块的压缩流拼接后仍是一个标准的 zlib 流，输出的是普通 PNG 文件。
+// Indexed8 图像（见 ColorQuantizer）写成带 PLTE/tRNS 的索引色 PNG。
+// 内置编码器需要 zlib（HAVE_ZLIB）；没有 zlib 时 write()/encode() 退回 QImageWriter，imageData() 返回空。
+class PngEncoder {
+public:
+    enum Preset {
+        Fastest,  // Sub 过滤 + deflate 1 级，速度优先
+        Balanced, // 自适应过滤 + deflate 6 级
+        Smallest  // 自适应过滤 + deflate 9 级，体积优先
+    };
+
+    explicit PngEncoder(Preset preset = Balanced);
+
+    QByteArray encode(const QImage &image) const;
+    bool write(const QImage &image, QIODevice *device) const;
+    // 只返回 IDAT 中的 zlib 数据流，像素格式的选择与 write() 相同（APNG 的各帧用它）
+    QByteArray imageData(const QImage &image) const;
+
+    static QString presetName(Preset preset);
+    static bool isBuiltin(); // 是否使用内置的并行编码器
+
+private:
+    Preset preset;
+};
+
+#endif // PNGENCODER_H
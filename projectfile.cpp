@@ -0,0 +1,369 @@
+#include "projectfile.h"
+#include "qoicodec.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QDataStream>
+#include <QtEndian>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cstring>
+#include <climits>
+
+static const char Magic[8] = {'S', 'S', 'H', 'O', 'T', 'P', 'R', 'J'};
+static const quint32 Version = 1;
+static const int HeaderSize = 64;
+static const int SectionEntrySize = 32;
+static const int PixelAlignment = 64;
+
+enum SectionType : quint32 {
+    ShapeTableSection = 1,
+    EditorStateSection = 2,
+    CaptureRawSection = 3,  // 参数：QImage::Format 和每行字节数
+    CaptureQoiSection = 4
+};
+
+struct Section {
+    quint32 type = 0;
+    quint32 format = 0;
+    quint32 bytesPerLine = 0;
+    quint64 offset = 0;
+    quint64 size = 0;
+};
+
+static void putUInt32(uchar *out, quint32 value) { qToLittleEndian(value, out); }
+static void putUInt64(uchar *out, quint64 value) { qToLittleEndian(value, out); }
+static quint32 getUInt32(const uchar *in) { return qFromLittleEndian<quint32>(in); }
+static quint64 getUInt64(const uchar *in) { return qFromLittleEndian<quint64>(in); }
+
+QDataStream &operator<<(QDataStream &out, const Shape &shape)
+{
+    out << qint32(shape.type) << shape.rect << shape.points << shape.text << qint32(shape.width) << shape.color
+        << qint32(shape.number) << shape.bubbleRect << shape.bubbleColor << shape.bubbleBorderColor;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, Shape &shape)
+{
+    qint32 type, width, number;
+    in >> type >> shape.rect >> shape.points >> shape.text >> width >> shape.color
+       >> number >> shape.bubbleRect >> shape.bubbleColor >> shape.bubbleBorderColor;
+    shape.type = ShapeType(type);
+    shape.width = width;
+    shape.number = number;
+    return in;
+}
+
+QDataStream &operator<<(QDataStream &out, const ExportSlice &slice)
+{
+    out << slice.name << slice.rect;
+    return out;
+}
+
+QDataStream &operator>>(QDataStream &in, ExportSlice &slice)
+{
+    in >> slice.name >> slice.rect;
+    return in;
+}
+
+// 形状表：数量，每个形状 {偏移, 长度}（相对节起点），随后是各形状的记录
+static QByteArray writeShapeTable(const QList<Shape> &shapes)
+{
+    QList<QByteArray> records;
+    for (const Shape &shape : shapes) {
+        QByteArray record;
+        QDataStream stream(&record, QIODevice::WriteOnly);
+        stream.setVersion(ProjectFile::StreamVersion);
+        stream << shape;
+        records.append(record);
+    }
+    QByteArray table(4 + records.size() * 8, 0);
+    uchar *entry = reinterpret_cast<uchar *>(table.data());
+    putUInt32(entry, quint32(records.size()));
+    quint32 offset = quint32(table.size());
+    for (int i = 0; i < records.size(); ++i) {
+        putUInt32(entry + 4 + i * 8, offset);
+        putUInt32(entry + 8 + i * 8, quint32(records[i].size()));
+        offset += quint32(records[i].size());
+    }
+    for (const QByteArray &record : records) {
+        table.append(record);
+    }
+    return table;
+}
+
+static bool readShapeTable(const uchar *data, quint64 size, QList<Shape> &shapes)
+{
+    if (size < 4) {
+        return false;
+    }
+    quint32 count = getUInt32(data);
+    if (4 + quint64(count) * 8 > size) {
+        return false;
+    }
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 offset = getUInt32(data + 4 + i * 8);
+        quint32 length = getUInt32(data + 8 + i * 8);
+        if (quint64(offset) + length > size) {
+            return false;
+        }
+        QByteArray record = QByteArray::fromRawData(reinterpret_cast<const char *>(data + offset), int(length));
+        QDataStream stream(record);
+        stream.setVersion(ProjectFile::StreamVersion);
+        Shape shape;
+        stream >> shape;
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+        shapes.append(shape);
+    }
+    return true;
+}
+
+static QByteArray writeEditorState(const ProjectData &data)
+{
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << qint32(data.noteNumber) << qint32(data.fontSize) << data.textColor << qint32(data.mosaicSize)
+           << qint32(data.shapeBorderWidth) << data.shapeBorderColor << qint32(data.penWidth) << data.penColor;
+    stream << quint32(data.slices.size());
+    for (const ExportSlice &slice : data.slices) {
+        stream << slice;
+    }
+    return state;
+}
+
+static bool readEditorState(const uchar *data, quint64 size, ProjectData &project)
+{
+    QByteArray state = QByteArray::fromRawData(reinterpret_cast<const char *>(data), int(size));
+    QDataStream stream(state);
+    stream.setVersion(ProjectFile::StreamVersion);
+    qint32 noteNumber, fontSize, mosaicSize, shapeBorderWidth, penWidth;
+    quint32 sliceCount;
+    stream >> noteNumber >> fontSize >> project.textColor >> mosaicSize
+           >> shapeBorderWidth >> project.shapeBorderColor >> penWidth >> project.penColor >> sliceCount;
+    for (quint32 i = 0; i < sliceCount && stream.status() == QDataStream::Ok; ++i) {
+        ExportSlice slice;
+        stream >> slice;
+        project.slices.append(slice);
+    }
+    project.noteNumber = noteNumber;
+    project.fontSize = fontSize;
+    project.mosaicSize = mosaicSize;
+    project.shapeBorderWidth = shapeBorderWidth;
+    project.penWidth = penWidth;
+    return stream.status() == QDataStream::Ok;
+}
+
+static bool writePadding(QIODevice *device, qint64 alignment)
+{
+    qint64 padding = (alignment - device->pos() % alignment) % alignment;
+    return device->write(QByteArray(int(padding), 0)) == padding;
+}
+
+bool ProjectFile::save(const QString &filePath, const ProjectData &data, Compression compression)
+{
+    if (data.capture.isNull()) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    bool ok = file.write(QByteArray(HeaderSize, 0)) == HeaderSize;
+
+    QList<Section> sections;
+    auto writeSection = [&file, &ok, &sections](Section section, const QByteArray &payload) {
+        section.offset = quint64(file.pos());
+        section.size = quint64(payload.size());
+        ok = ok && file.write(payload) == payload.size();
+        sections.append(section);
+    };
+
+    Section shapeTable;
+    shapeTable.type = ShapeTableSection;
+    writeSection(shapeTable, writeShapeTable(data.shapes));
+    Section editorState;
+    editorState.type = EditorStateSection;
+    writeSection(editorState, writeEditorState(data));
+
+    // 原始像素使用 QImage 自身的格式和行宽，加载时映射后即可直接使用
+    Section capture;
+    if (compression == Qoi) {
+        QByteArray qoi;
+        QBuffer buffer(&qoi);
+        buffer.open(QIODevice::WriteOnly);
+        ok = ok && QoiWriter::write(data.capture, &buffer);
+        capture.type = CaptureQoiSection;
+        writeSection(capture, qoi);
+    } else {
+        QImage image = data.capture;
+        if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32_Premultiplied) {
+            image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+        }
+        ok = ok && writePadding(&file, PixelAlignment);
+        capture.type = CaptureRawSection;
+        capture.format = quint32(image.format());
+        capture.bytesPerLine = quint32(image.bytesPerLine());
+        writeSection(capture, QByteArray::fromRawData(reinterpret_cast<const char *>(image.constBits()), int(image.sizeInBytes())));
+    }
+
+    quint64 indexOffset = quint64(file.pos());
+    QByteArray index(sections.size() * SectionEntrySize, 0);
+    for (int i = 0; i < sections.size(); ++i) {
+        uchar *entry = reinterpret_cast<uchar *>(index.data()) + i * SectionEntrySize;
+        putUInt32(entry, sections[i].type);
+        putUInt32(entry + 4, sections[i].format);
+        putUInt32(entry + 8, sections[i].bytesPerLine);
+        putUInt32(entry + 12, 0);
+        putUInt64(entry + 16, sections[i].offset);
+        putUInt64(entry + 24, sections[i].size);
+    }
+    ok = ok && file.write(index) == index.size();
+
+    uchar header[HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, Magic, sizeof(Magic));
+    putUInt32(header + 8, Version);
+    putUInt32(header + 12, HeaderSize);
+    putUInt32(header + 16, quint32(sections.size()));
+    putUInt64(header + 24, indexOffset);
+    putUInt32(header + 32, quint32(data.capture.width()));
+    putUInt32(header + 36, quint32(data.capture.height()));
+    putUInt32(header + 40, quint32(data.viewport.x()));
+    putUInt32(header + 44, quint32(data.viewport.y()));
+    putUInt32(header + 48, quint32(data.viewport.width()));
+    putUInt32(header + 52, quint32(data.viewport.height()));
+    ok = ok && file.seek(0) && file.write(reinterpret_cast<const char *>(header), HeaderSize) == HeaderSize;
+    ok = ok && file.commit();
+
+    qDebug() << "ProjectFile: Saved" << filePath << ", compression:" << (compression == Qoi ? "qoi" : "raw")
+             << ", shapes:" << data.shapes.size() << ", time:" << timer.elapsed() << "ms, ok:" << ok;
+    return ok;
+}
+
+bool ProjectFile::isProject(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return file.read(sizeof(Magic)) == QByteArray(Magic, sizeof(Magic));
+}
+
+static void releaseMappedFile(void *info)
+{
+    delete static_cast<QFile *>(info); // 关闭文件时自动解除映射
+}
+
+bool ProjectFile::load(const QString &filePath, ProjectData &data)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile *file = new QFile(filePath);
+    if (!file->open(QIODevice::ReadOnly) || file->size() < HeaderSize) {
+        delete file;
+        return false;
+    }
+    quint64 fileSize = quint64(file->size());
+    const uchar *map = file->map(0, file->size());
+    QByteArray fallback;
+    if (!map) {
+        // 不支持映射的文件系统上退回到整体读取
+        fallback = file->readAll();
+        map = reinterpret_cast<const uchar *>(fallback.constData());
+    }
+
+    auto fail = [file](const char *reason) {
+        qDebug() << "ProjectFile: Failed to load:" << reason;
+        delete file;
+        return false;
+    };
+    if (memcmp(map, Magic, sizeof(Magic)) != 0) {
+        return fail("bad magic");
+    }
+    if (getUInt32(map + 8) > Version) {
+        return fail("unsupported version");
+    }
+    quint32 sectionCount = getUInt32(map + 16);
+    quint64 indexOffset = getUInt64(map + 24);
+    // 帧头里的偏移和长度都不可信，先减后除，避免相加或相乘溢出后绕过检查
+    if (indexOffset > fileSize || sectionCount > (fileSize - indexOffset) / SectionEntrySize) {
+        return fail("truncated index");
+    }
+    int width = int(getUInt32(map + 32));
+    int height = int(getUInt32(map + 36));
+    data.viewport = QRect(int(getUInt32(map + 40)), int(getUInt32(map + 44)),
+                          int(getUInt32(map + 48)), int(getUInt32(map + 52)));
+
+    QList<Section> sections;
+    for (quint32 i = 0; i < sectionCount; ++i) {
+        const uchar *entry = map + indexOffset + i * SectionEntrySize;
+        Section section;
+        section.type = getUInt32(entry);
+        section.format = getUInt32(entry + 4);
+        section.bytesPerLine = getUInt32(entry + 8);
+        section.offset = getUInt64(entry + 16);
+        section.size = getUInt64(entry + 24);
+        if (section.offset > fileSize || section.size > fileSize - section.offset) {
+            return fail("section out of range");
+        }
+        sections.append(section);
+    }
+
+    Section capture;
+    for (const Section &section : sections) {
+        const uchar *payload = map + section.offset;
+        bool ok = true;
+        if (section.type == ShapeTableSection) {
+            ok = readShapeTable(payload, section.size, data.shapes);
+        } else if (section.type == EditorStateSection) {
+            ok = readEditorState(payload, section.size, data);
+        } else if (section.type == CaptureRawSection || section.type == CaptureQoiSection) {
+            capture = section;
+        }
+        if (!ok) {
+            return fail("bad section");
+        }
+    }
+
+    const uchar *pixels = map + capture.offset;
+    bool mapped = false;
+    if (capture.type == CaptureQoiSection) {
+        if (capture.size > quint64(INT_MAX)) {
+            return fail("bad capture");
+        }
+        data.capture = QoiReader::decode(QByteArray::fromRawData(reinterpret_cast<const char *>(pixels), int(capture.size)));
+    } else if (capture.type == CaptureRawSection) {
+        QImage::Format format = QImage::Format(capture.format);
+        if (width <= 0 || height <= 0 || quint64(capture.bytesPerLine) < quint64(width) * 4
+            || capture.bytesPerLine > quint32(INT_MAX) || quint64(capture.bytesPerLine) * height > capture.size
+            || (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32_Premultiplied)) {
+            return fail("bad capture");
+        }
+        if (fallback.isEmpty()) {
+            // 像素直接引用映射的内存，QImage 释放时关闭文件；只读数据在写入时会自动分离拷贝
+            data.capture = QImage(pixels, width, height, int(capture.bytesPerLine), format, releaseMappedFile, file);
+            // 构造失败时 QImage 不会调用清理函数，文件由下面关闭
+            mapped = !data.capture.isNull();
+        } else {
+            data.capture = QImage(pixels, width, height, int(capture.bytesPerLine), format).copy();
+        }
+    }
+    if (!mapped) {
+        delete file;
+    }
+    if (data.capture.isNull()) {
+        qDebug() << "ProjectFile: Failed to load: no capture";
+        return false;
+    }
+
+    qDebug() << "ProjectFile: Loaded" << filePath << data.capture.size() << ", mapped:" << mapped
+             << ", shapes:" << data.shapes.size() << ", time:" << timer.elapsed() << "ms";
+    return true;
+}
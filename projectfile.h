@@ -0,0 +1,51 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <QImage>
+#include <QRect>
+#include <QList>
+#include <QColor>
+#include <QString>
+#include <QDataStream>
+#include "shape.h"
+#include "exportpipeline.h"
+
+// 一个可再次编辑的截图项目：原始截图、形状和编辑器状态
+struct ProjectData {
+    QImage capture;
+    QRect viewport;
+    QList<Shape> shapes;
+    QList<ExportSlice> slices;
+    int noteNumber = 1;
+    int fontSize = 16;
+    QColor textColor = Qt::black;
+    int mosaicSize = 10;
+    int shapeBorderWidth = 2;
+    QColor shapeBorderColor = Qt::black;
+    int penWidth = 2;
+    QColor penColor = Qt::black;
+};
+
+// .sshot 项目文件（小端序）：
+//   固定 64 字节文件头：魔数 "SSHOTPRJ"、版本、节数量、节索引的偏移、截图尺寸和视口
+//   若干节：形状表、编辑器状态、截图像素（原始像素按 64 字节对齐，或 QOI 压缩）
+//   节索引：每节一项 {类型, 编码参数, 偏移, 长度}
+// 读取时整个文件用 QFile::map 映射，原始像素直接作为 QImage 的数据，不需要解码和拷贝。
+class ProjectFile {
+public:
+    enum Compression { Raw, Qoi };
+
+    // 项目文件和会话日志中形状记录使用的序列化版本
+    static const QDataStream::Version StreamVersion = QDataStream::Qt_5_15;
+
+    static bool save(const QString &filePath, const ProjectData &data, Compression compression = Raw);
+    static bool load(const QString &filePath, ProjectData &data);
+    static bool isProject(const QString &filePath);
+};
+
+QDataStream &operator<<(QDataStream &out, const Shape &shape);
+QDataStream &operator>>(QDataStream &in, Shape &shape);
+QDataStream &operator<<(QDataStream &out, const ExportSlice &slice);
+QDataStream &operator>>(QDataStream &in, ExportSlice &slice);
+
+#endif // PROJECTFILE_H
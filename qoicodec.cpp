@@ -0,0 +1,231 @@
+#include "qoicodec.h"
+#include <QDebug>
+#include <cstring>
+
+static const uchar QoiOpIndex = 0x00;
+static const uchar QoiOpDiff = 0x40;
+static const uchar QoiOpLuma = 0x80;
+static const uchar QoiOpRun = 0xC0;
+static const uchar QoiOpRgb = 0xFE;
+static const uchar QoiOpRgba = 0xFF;
+static const uchar QoiMask = 0xC0;
+static const int QoiHeaderSize = 14;
+static const uchar QoiPadding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+static const int FlushThreshold = 64 * 1024;
+
+static inline int qoiHash(QRgb pixel)
+{
+    return (qRed(pixel) * 3 + qGreen(pixel) * 5 + qBlue(pixel) * 7 + qAlpha(pixel) * 11) % 64;
+}
+
+static inline void writeUInt32(uchar *out, quint32 value)
+{
+    out[0] = uchar(value >> 24);
+    out[1] = uchar(value >> 16);
+    out[2] = uchar(value >> 8);
+    out[3] = uchar(value);
+}
+
+static inline quint32 readUInt32(const uchar *in)
+{
+    return (quint32(in[0]) << 24) | (quint32(in[1]) << 16) | (quint32(in[2]) << 8) | quint32(in[3]);
+}
+
+QoiWriter::QoiWriter(QIODevice *device)
+    : device(device)
+{
+    memset(index, 0, sizeof(index));
+}
+
+bool QoiWriter::begin(int width, int height, bool alpha)
+{
+    uchar header[QoiHeaderSize];
+    memcpy(header, "qoif", 4);
+    writeUInt32(header + 4, quint32(width));
+    writeUInt32(header + 8, quint32(height));
+    header[12] = alpha ? 4 : 3;
+    header[13] = 0; // sRGB
+    buffer.append(reinterpret_cast<const char *>(header), QoiHeaderSize);
+    remainingPixels = qint64(width) * height;
+    return width > 0 && height > 0;
+}
+
+bool QoiWriter::writeRow(const QRgb *pixels, int count)
+{
+    // 每个像素最多 5 字节，先按最坏情况扩容，再用指针直接写入
+    int oldSize = buffer.size();
+    buffer.resize(oldSize + count * 5 + 1);
+    uchar *out = reinterpret_cast<uchar *>(buffer.data()) + oldSize;
+
+    for (int i = 0; i < count; ++i) {
+        QRgb pixel = pixels[i];
+        --remainingPixels;
+        if (pixel == previous) {
+            ++run;
+            if (run == 62 || remainingPixels == 0) {
+                *out++ = QoiOpRun | uchar(run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *out++ = QoiOpRun | uchar(run - 1);
+            run = 0;
+        }
+
+        int hash = qoiHash(pixel);
+        if (index[hash] == pixel) {
+            *out++ = QoiOpIndex | uchar(hash);
+        } else {
+            index[hash] = pixel;
+            if (qAlpha(pixel) == qAlpha(previous)) {
+                signed char vr = static_cast<signed char>(qRed(pixel) - qRed(previous));
+                signed char vg = static_cast<signed char>(qGreen(pixel) - qGreen(previous));
+                signed char vb = static_cast<signed char>(qBlue(pixel) - qBlue(previous));
+                signed char vgr = static_cast<signed char>(vr - vg);
+                signed char vgb = static_cast<signed char>(vb - vg);
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    *out++ = QoiOpDiff | uchar((vr + 2) << 4) | uchar((vg + 2) << 2) | uchar(vb + 2);
+                } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                    *out++ = QoiOpLuma | uchar(vg + 32);
+                    *out++ = uchar((vgr + 8) << 4) | uchar(vgb + 8);
+                } else {
+                    *out++ = QoiOpRgb;
+                    *out++ = uchar(qRed(pixel));
+                    *out++ = uchar(qGreen(pixel));
+                    *out++ = uchar(qBlue(pixel));
+                }
+            } else {
+                *out++ = QoiOpRgba;
+                *out++ = uchar(qRed(pixel));
+                *out++ = uchar(qGreen(pixel));
+                *out++ = uchar(qBlue(pixel));
+                *out++ = uchar(qAlpha(pixel));
+            }
+        }
+        previous = pixel;
+    }
+
+    buffer.resize(int(out - reinterpret_cast<uchar *>(buffer.data())));
+    flush(false);
+    return ok;
+}
+
+bool QoiWriter::finish()
+{
+    if (run > 0) {
+        buffer.append(char(QoiOpRun | uchar(run - 1)));
+        run = 0;
+    }
+    buffer.append(reinterpret_cast<const char *>(QoiPadding), sizeof(QoiPadding));
+    flush(true);
+    return ok && remainingPixels == 0;
+}
+
+void QoiWriter::flush(bool force)
+{
+    if (buffer.isEmpty() || (!force && buffer.size() < FlushThreshold)) {
+        return;
+    }
+    ok = ok && device->write(buffer) == buffer.size();
+    buffer.resize(0); // 保留已分配的容量
+}
+
+bool QoiWriter::write(const QImage &image, QIODevice *device)
+{
+    if (image.isNull() || !device) {
+        return false;
+    }
+    bool alpha = image.hasAlphaChannel();
+    QImage source = image;
+    if (source.format() != QImage::Format_RGB32 && source.format() != QImage::Format_ARGB32) {
+        source = source.convertToFormat(alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    }
+
+    QoiWriter writer(device);
+    if (!writer.begin(source.width(), source.height(), alpha)) {
+        return false;
+    }
+    for (int y = 0; y < source.height(); ++y) {
+        if (!writer.writeRow(reinterpret_cast<const QRgb *>(source.constScanLine(y)), source.width())) {
+            return false;
+        }
+    }
+    return writer.finish();
+}
+
+bool QoiReader::canRead(QIODevice *device)
+{
+    return device && device->peek(4) == "qoif";
+}
+
+QImage QoiReader::read(QIODevice *device)
+{
+    if (!canRead(device)) {
+        return QImage();
+    }
+    return decode(device->readAll());
+}
+
+QImage QoiReader::decode(const QByteArray &data)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    if (data.size() < QoiHeaderSize + int(sizeof(QoiPadding)) || memcmp(bytes, "qoif", 4) != 0) {
+        return QImage();
+    }
+    int width = int(readUInt32(bytes + 4));
+    int height = int(readUInt32(bytes + 8));
+    int channels = bytes[12];
+    if (width <= 0 || height <= 0 || (channels != 3 && channels != 4)) {
+        return QImage();
+    }
+
+    QImage image(width, height, channels == 4 ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    if (image.isNull()) {
+        return image;
+    }
+
+    QRgb index[64];
+    memset(index, 0, sizeof(index));
+    QRgb pixel = 0xFF000000;
+    int run = 0;
+    int position = QoiHeaderSize;
+    int end = data.size() - int(sizeof(QoiPadding));
+
+    for (int y = 0; y < height; ++y) {
+        QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            if (run > 0) {
+                --run;
+            } else if (position < end) {
+                uchar b1 = bytes[position++];
+                if (b1 == QoiOpRgb) {
+                    pixel = qRgba(bytes[position], bytes[position + 1], bytes[position + 2], qAlpha(pixel));
+                    position += 3;
+                } else if (b1 == QoiOpRgba) {
+                    pixel = qRgba(bytes[position], bytes[position + 1], bytes[position + 2], bytes[position + 3]);
+                    position += 4;
+                } else if ((b1 & QoiMask) == QoiOpIndex) {
+                    pixel = index[b1];
+                } else if ((b1 & QoiMask) == QoiOpDiff) {
+                    pixel = qRgba(qRed(pixel) + ((b1 >> 4) & 0x03) - 2,
+                                  qGreen(pixel) + ((b1 >> 2) & 0x03) - 2,
+                                  qBlue(pixel) + (b1 & 0x03) - 2,
+                                  qAlpha(pixel));
+                } else if ((b1 & QoiMask) == QoiOpLuma) {
+                    uchar b2 = bytes[position++];
+                    int vg = (b1 & 0x3F) - 32;
+                    pixel = qRgba(qRed(pixel) + vg - 8 + ((b2 >> 4) & 0x0F),
+                                  qGreen(pixel) + vg,
+                                  qBlue(pixel) + vg - 8 + (b2 & 0x0F),
+                                  qAlpha(pixel));
+                } else if ((b1 & QoiMask) == QoiOpRun) {
+                    run = b1 & 0x3F;
+                }
+                index[qoiHash(pixel)] = pixel;
+            }
+            row[x] = pixel;
+        }
+    }
+    return image;
+}
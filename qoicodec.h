@@ -0,0 +1,40 @@
+#ifndef QOICODEC_H
+#define QOICODEC_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QIODevice>
+#include <QRgb>
+
+// QOI（Quite OK Image）格式的流式编码器：逐行写入像素，编码结果按块写到设备，
+// 不需要在内存中保留整幅编码结果。
+class QoiWriter {
+public:
+    explicit QoiWriter(QIODevice *device);
+
+    bool begin(int width, int height, bool alpha);
+    bool writeRow(const QRgb *pixels, int count); // 非预乘 ARGB32 像素
+    bool finish();
+
+    static bool write(const QImage &image, QIODevice *device);
+
+private:
+    QIODevice *device;
+    QByteArray buffer;
+    QRgb index[64];
+    QRgb previous = 0xFF000000;
+    int run = 0;
+    qint64 remainingPixels = 0;
+    bool ok = true;
+
+    void flush(bool force);
+};
+
+class QoiReader {
+public:
+    static bool canRead(QIODevice *device);
+    static QImage read(QIODevice *device);
+    static QImage decode(const QByteArray &data);
+};
+
+#endif // QOICODEC_H
@@ -0,0 +1,49 @@
+#include "recordwindow.h"
+#include "regionrecorder.h"
+#include "capturepanel.h"
+#include <QLabel>
+#include <QPushButton>
+#include <QHBoxLayout>
+#include <QMessageBox>
+
+RecordWindow::RecordWindow(const QRect &region, const QString &filePath, AnimationWriter::Format format, QWidget *parent)
+    : QWidget(parent)
+{
+    setWindowFlags(Qt::Tool | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    statusLabel = new QLabel("录制中 0.0 秒", this);
+    statusLabel->setMinimumWidth(180);
+    stopButton = new QPushButton("停止", this);
+    QHBoxLayout *layout = new QHBoxLayout(this);
+    layout->addWidget(statusLabel);
+    layout->addWidget(stopButton);
+    layout->setContentsMargins(5, 5, 5, 5);
+    setLayout(layout);
+
+    adjustSize();
+    QRect grabRegion = CapturePanel::place(this, region);
+    recorder = new RegionRecorder(grabRegion, filePath, format, this);
+    connect(recorder, &RegionRecorder::progress, this, [this]() {
+        if (!stopButton->isEnabled()) {
+            return; // 已停止，排队中的进度不再覆盖提示
+        }
+        statusLabel->setText(QString("录制中 %1 秒，%2 帧").arg(recorder->elapsed() / 1000.0, 0, 'f', 1).arg(recorder->capturedFrames()));
+    });
+    connect(recorder, &RegionRecorder::finished, this, [this](bool ok) {
+        hide();
+        if (!ok) {
+            QMessageBox::warning(nullptr, "录制失败", recorder->errorString());
+        }
+        emit finished(ok);
+        close();
+    });
+    connect(stopButton, &QPushButton::clicked, this, [this]() {
+        stopButton->setEnabled(false);
+        statusLabel->setText("正在写入剩余的帧…");
+        recorder->stop();
+    });
+
+    show();
+    recorder->start();
+}
@@ -0,0 +1,27 @@
+#ifndef RECORDWINDOW_H
+#define RECORDWINDOW_H
+
+#include <QWidget>
+#include "animationwriter.h"
+
+class QLabel;
+class QPushButton;
+class RegionRecorder;
+
+// 录制动画时的控制面板：尽量放在选区外侧，显示已录制的时长和帧数，停止后等待编码完成，失败时提示原因
+class RecordWindow : public QWidget {
+    Q_OBJECT
+
+public:
+    RecordWindow(const QRect &region, const QString &filePath, AnimationWriter::Format format, QWidget *parent = nullptr);
+
+signals:
+    void finished(bool ok);
+
+private:
+    RegionRecorder *recorder;
+    QLabel *statusLabel;
+    QPushButton *stopButton;
+};
+
+#endif // RECORDWINDOW_H
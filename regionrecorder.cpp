@@ -0,0 +1,402 @@
+#include "regionrecorder.h"
+#include "livecapture.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QThread>
+#include <QTimer>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QDebug>
+#include <cstring>
+
+static const qint64 MaxQueuedBytes = 128LL * 1024 * 1024; // 队列中留在内存里的像素上限
+static const int BlockPixels = 64; // 逐块比较，每块内部无分支，编译器可以向量化
+
+// 一行中 [first, last] 范围内第一个不同的像素，找不到返回 -1
+static int firstDifference(const quint32 *a, const quint32 *b, int first, int last)
+{
+    for (int x = first; x <= last; ++x) {
+        if (a[x] != b[x]) {
+            return x;
+        }
+    }
+    return -1;
+}
+
+static int lastDifference(const quint32 *a, const quint32 *b, int first, int last)
+{
+    for (int x = last; x >= first; --x) {
+        if (a[x] != b[x]) {
+            return x;
+        }
+    }
+    return -1;
+}
+
+// 两帧之间所有变化像素的外接矩形，没有变化时返回空矩形
+static QRect dirtyRect(const QImage &before, const QImage &after)
+{
+    const int width = after.width();
+    int top = -1;
+    int bottom = -1;
+    int left = width;
+    int right = -1;
+    for (int y = 0; y < after.height(); ++y) {
+        const quint32 *a = reinterpret_cast<const quint32 *>(before.constScanLine(y));
+        const quint32 *b = reinterpret_cast<const quint32 *>(after.constScanLine(y));
+        int firstBlock = -1;
+        int lastBlock = -1;
+        for (int x = 0; x < width; x += BlockPixels) {
+            const int count = qMin(BlockPixels, width - x);
+            quint32 diff = 0;
+            for (int i = 0; i < count; ++i) {
+                diff |= a[x + i] ^ b[x + i];
+            }
+            if (diff) {
+                if (firstBlock < 0) {
+                    firstBlock = x;
+                }
+                lastBlock = x;
+            }
+        }
+        if (firstBlock < 0) {
+            continue;
+        }
+        if (top < 0) {
+            top = y;
+        }
+        bottom = y;
+        // 只在可能扩大左右边界的块里逐像素查找
+        if (firstBlock < left) {
+            left = qMin(left, firstDifference(a, b, firstBlock, qMin(firstBlock + BlockPixels, width) - 1));
+        }
+        if (lastBlock + BlockPixels - 1 > right) {
+            right = qMax(right, lastDifference(a, b, lastBlock, qMin(lastBlock + BlockPixels, width) - 1));
+        }
+    }
+    if (top < 0) {
+        return QRect();
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+RegionRecorder::RegionRecorder(const QRect &region, const QString &filePath, AnimationWriter::Format format, QObject *parent)
+    : QObject(parent), region(region), filePath(filePath), format(format)
+{
+}
+
+RegionRecorder::~RegionRecorder()
+{
+    if (grabber) {
+        stop();
+        grabber->wait();
+        delete grabber;
+    }
+    if (encoder) {
+        {
+            QMutexLocker locker(&mutex);
+            stopping = true;
+            if (endTimestamp == 0) {
+                endTimestamp = elapsed();
+            }
+        }
+        wake.wakeOne();
+        encoder->wait();
+        delete encoder;
+    }
+    delete spill;
+}
+
+void RegionRecorder::start()
+{
+    // 屏幕列表只能在界面线程中查询，抓取线程一直使用这里选定的屏幕
+    screen = QGuiApplication::screenAt(region.center());
+    if (!screen) {
+        screen = QGuiApplication::primaryScreen();
+    }
+    spill = new QTemporaryFile(QDir::temp().filePath("screenshot_recording_XXXXXX.bin"));
+    if (!spill->open()) {
+        qDebug() << "RegionRecorder: Failed to create spill file, queue is limited to memory";
+        delete spill;
+        spill = nullptr;
+    }
+    encoder = QThread::create([this]() {
+        run();
+    });
+    connect(encoder, &QThread::finished, this, [this]() {
+        // 编码线程要等抓取线程交出最后一帧才会结束，这里抓取线程已经或即将退出
+        grabber->wait();
+        const int frames = captured.loadRelaxed();
+        qDebug() << "RegionRecorder: Captured" << frames << "frames (" << unchanged << "unchanged," << missedTicks
+                 << "ticks missed), grab avg" << (frames > 0 ? grabMsTotal / frames : 0) << "ms, max" << grabMsMax << "ms";
+        emit finished(ok);
+    });
+    const bool threaded = LiveCapture::workerGrabSupported();
+    grabber = QThread::create([this, threaded]() {
+        if (threaded) {
+            grabLoop();
+        } else {
+            compareLoop();
+        }
+    });
+    clock.start();
+    encoder->start();
+    grabber->start(QThread::HighPriority);
+    if (!threaded) {
+        qDebug() << "RegionRecorder: Grabbing on the GUI thread for platform" << QGuiApplication::platformName();
+        grabTimer = new QTimer(this);
+        grabTimer->setTimerType(Qt::PreciseTimer);
+        grabTimer->setInterval(1000 / FramesPerSecond);
+        connect(grabTimer, &QTimer::timeout, this, &RegionRecorder::grabOnGuiThread);
+        grabTimer->start();
+        grabOnGuiThread();
+    }
+}
+
+void RegionRecorder::stop()
+{
+    if (grabTimer) {
+        grabTimer->stop();
+    }
+    QMutexLocker locker(&frameMutex);
+    stopGrabbing.storeRelease(1);
+    frameReady.wakeOne();
+}
+
+// 抓取线程：第 n 帧安排在 n / FramesPerSecond 秒。一次抓取超过一个周期时，错过的时刻直接跳过，
+// 下一帧对齐到之后最近的时刻，不会为了追赶而连续抓取；跳过的次数记在日志里
+void RegionRecorder::grabLoop()
+{
+    const qint64 interval = 1000 / FramesPerSecond;
+    qint64 next = 0;
+    while (!stopGrabbing.loadAcquire()) {
+        qint64 now = elapsed();
+        if (now < next) {
+            QThread::msleep(quint64(next - now));
+            continue;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 timestamp = elapsed();
+        const QImage frame = grabRegion();
+        addFrame(frame, timestamp, timer.elapsed());
+        next += interval;
+        now = elapsed();
+        if (now >= next + interval) {
+            const qint64 missed = (now - next) / interval;
+            missedTicks += int(missed);
+            next += missed * interval;
+        }
+    }
+    finishGrabbing();
+}
+
+// 界面线程抓取时的工作线程：等待界面线程交来的帧并与上一帧比较
+void RegionRecorder::compareLoop()
+{
+    forever {
+        QImage frame;
+        qint64 timestamp = 0;
+        qint64 grabMs = 0;
+        {
+            QMutexLocker locker(&frameMutex);
+            while (pendingFrame.isNull() && !stopGrabbing.loadAcquire()) {
+                frameReady.wait(&frameMutex);
+            }
+            if (pendingFrame.isNull()) {
+                break;
+            }
+            frame = pendingFrame;
+            pendingFrame = QImage();
+            timestamp = pendingTimestamp;
+            grabMs = pendingGrabMs;
+        }
+        addFrame(frame, timestamp, grabMs);
+    }
+    missedTicks += droppedFrames;
+    finishGrabbing();
+}
+
+// 界面线程的定时器：只抓取，比较和入队留给工作线程。工作线程还没取走上一帧时直接覆盖，
+// 定时器本身在界面繁忙时也会合并超时，这部分不计入跳过的时刻
+void RegionRecorder::grabOnGuiThread()
+{
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 timestamp = elapsed();
+    QImage frame = grabRegion();
+    const qint64 grabMs = timer.elapsed();
+    QMutexLocker locker(&frameMutex);
+    if (stopGrabbing.loadAcquire() || frame.isNull()) {
+        return;
+    }
+    if (!pendingFrame.isNull()) {
+        ++droppedFrames;
+    }
+    pendingFrame = frame;
+    pendingTimestamp = timestamp;
+    pendingGrabMs = grabMs;
+    frameReady.wakeOne();
+}
+
+void RegionRecorder::finishGrabbing()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        endTimestamp = elapsed();
+    }
+    wake.wakeOne();
+}
+
+QImage RegionRecorder::grabRegion() const
+{
+    QRect local = region.translated(-screen->geometry().topLeft());
+    return screen->grabWindow(0, local.x(), local.y(), local.width(), local.height()).toImage()
+        .convertToFormat(QImage::Format_RGB32);
+}
+
+void RegionRecorder::addFrame(const QImage &frame, qint64 timestamp, qint64 grabMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (frame.isNull() || (!previous.isNull() && frame.size() != previous.size())) {
+        return;
+    }
+
+    Delta delta;
+    delta.timestamp = timestamp;
+    delta.rect = previous.isNull() ? frame.rect() : dirtyRect(previous, frame);
+    if (delta.rect.isEmpty()) {
+        ++unchanged;
+    } else {
+        delta.patch = delta.rect == frame.rect() ? frame : frame.copy(delta.rect);
+        enqueue(delta);
+    }
+    previous = frame;
+    captured.fetchAndAddRelaxed(1);
+
+    qint64 ms = grabMs + timer.elapsed();
+    grabMsTotal += ms;
+    grabMsMax = qMax(grabMsMax, ms);
+    emit progress();
+}
+
+void RegionRecorder::enqueue(Delta delta)
+{
+    const qint64 bytes = delta.patch.sizeInBytes();
+    {
+        QMutexLocker locker(&mutex);
+        // 溢出文件里的帧都已读回时，从头复用文件
+        if (spill && spilledPending == 0 && spill->pos() > 0) {
+            spill->resize(0);
+            spill->seek(0);
+        }
+        if (spill && queuedBytes + bytes > MaxQueuedBytes) {
+            delta.spillOffset = spill->pos();
+            bool written = true;
+            const int rowBytes = delta.rect.width() * 4;
+            for (int y = 0; y < delta.patch.height() && written; ++y) {
+                written = spill->write(reinterpret_cast<const char *>(delta.patch.constScanLine(y)), rowBytes) == rowBytes;
+            }
+            if (written && spill->flush()) {
+                delta.patch = QImage();
+                ++spilledPending;
+            } else {
+                // 磁盘写不进去时宁可多占内存，也不丢帧
+                qDebug() << "RegionRecorder: Failed to spill frame, keeping it in memory";
+                delta.spillOffset = -1;
+            }
+        }
+        if (delta.spillOffset < 0) {
+            queuedBytes += bytes;
+        }
+        queue.append(delta);
+    }
+    wake.wakeOne();
+}
+
+QImage RegionRecorder::loadSpilled(QFile &file, const Delta &delta)
+{
+    if (!file.isOpen() && !file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+    QImage patch(delta.rect.size(), QImage::Format_RGB32);
+    const int rowBytes = delta.rect.width() * 4;
+    if (!file.seek(delta.spillOffset)) {
+        return QImage();
+    }
+    for (int y = 0; y < patch.height(); ++y) {
+        if (file.read(reinterpret_cast<char *>(patch.scanLine(y)), rowBytes) != rowBytes) {
+            return QImage();
+        }
+    }
+    return patch;
+}
+
+// 编码线程：帧的时长要等下一帧到达才知道，所以总是延后一帧写出
+void RegionRecorder::run()
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "RegionRecorder: Failed to open" << filePath;
+        error = QString("无法创建文件 %1：%2").arg(filePath, file.errorString());
+    }
+    QFile spillReader(spill ? spill->fileName() : QString());
+    AnimationWriter writer(&file, format);
+    bool writing = file.isOpen();
+    bool begun = false;
+    Delta held;
+    bool hasHeld = false;
+
+    forever {
+        Delta delta;
+        bool last = false;
+        {
+            QMutexLocker locker(&mutex);
+            while (queue.isEmpty() && !stopping) {
+                wake.wait(&mutex);
+            }
+            if (queue.isEmpty()) {
+                last = true;
+            } else {
+                delta = queue.takeFirst();
+                if (delta.spillOffset < 0) {
+                    queuedBytes -= delta.patch.sizeInBytes();
+                }
+            }
+        }
+        if (!last && delta.spillOffset >= 0) {
+            delta.patch = loadSpilled(spillReader, delta);
+            QMutexLocker locker(&mutex);
+            --spilledPending;
+        }
+
+        if (hasHeld && writing) {
+            qint64 next = last ? endTimestamp : delta.timestamp;
+            int delayMs = int(qMax<qint64>(next - held.timestamp, 1000 / FramesPerSecond));
+            if (!begun) {
+                begun = writer.begin(held.rect.size());
+                writing = begun;
+            }
+            writing = writing && writer.addFrame(held.rect, held.patch, delayMs);
+        }
+        if (last) {
+            break;
+        }
+        held = delta;
+        hasHeld = true;
+    }
+
+    ok = writing && writer.finish() && file.commit();
+    if (!ok) {
+        qDebug() << "RegionRecorder: Failed to write" << filePath;
+        if (error.isEmpty()) {
+            error = !begun ? QString("没有录到任何画面") : QString("写入 %1 失败：%2").arg(filePath, file.errorString());
+        }
+    } else {
+        qDebug() << "RegionRecorder: Saved" << writer.frameCount() << "frames to" << filePath;
+    }
+}
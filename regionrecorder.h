@@ -0,0 +1,106 @@
+#ifndef REGIONRECORDER_H
+#define REGIONRECORDER_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QFile>
+#include "animationwriter.h"
+
+class QThread;
+class QTimer;
+class QTemporaryFile;
+class QScreen;
+
+// 把屏幕上的一块区域录制成 APNG/GIF 动画。
+// 按固定的时间表抓取区域，与上一帧逐字比较得到变化的外接矩形，只把这一小块放进队列；
+// 画面没有变化的帧不入队，只延长前一帧的时长。抓取赶不上时间表时跳过错过的时刻并计数，
+// 不会连续补抓，帧的时长按实际抓取时间计算。
+// QScreen::grabWindow 只在 xcb 和 windows 平台插件上可以从非界面线程调用，这两个平台上
+// 抓取和比较都在抓取线程中，界面繁忙时不影响抓取；其它平台上由界面线程的定时器抓取，
+// 抓到的帧交给同一个工作线程比较。
+// 编码线程从队列取出子矩形交给 AnimationWriter，边录边写文件。
+// 队列中的像素超过上限时，新的子矩形先写进临时文件，内存占用不随录制时长增长。
+class RegionRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    RegionRecorder(const QRect &region, const QString &filePath, AnimationWriter::Format format, QObject *parent = nullptr);
+    ~RegionRecorder();
+
+    void start();
+    void stop(); // 停止抓取，编码线程写完队列中剩余的帧后发出 finished
+
+    int capturedFrames() const { return captured.loadRelaxed(); }
+    QString errorString() const { return error; } // finished(false) 之后的失败原因
+    qint64 elapsed() const { return clock.isValid() ? clock.elapsed() : 0; }
+
+    static const int FramesPerSecond = 30;
+
+signals:
+    void progress();
+    void finished(bool ok);
+
+private:
+    // 一帧中发生变化的部分；spillOffset >= 0 时像素在临时文件中
+    struct Delta {
+        QRect rect;
+        QImage patch;
+        qint64 spillOffset = -1;
+        qint64 timestamp = 0;
+    };
+
+    QRect region;      // 全局坐标
+    QString filePath;
+    AnimationWriter::Format format;
+    QElapsedTimer clock;
+
+    // 以下只由抓取线程访问，抓取线程结束后才在界面线程中读取统计
+    QThread *grabber = nullptr; // 不能在线程中抓取时只负责比较界面线程交来的帧
+    QScreen *screen = nullptr;
+    QAtomicInt stopGrabbing{0};
+    QAtomicInt captured{0};
+    QImage previous;
+    int unchanged = 0;
+    int missedTicks = 0; // 因上一次抓取超时而跳过的时刻
+    qint64 grabMsTotal = 0;
+    qint64 grabMsMax = 0;
+
+    // 界面线程抓取时交给抓取线程的帧，只保留最新的一帧，被覆盖的算作跳过的时刻
+    QTimer *grabTimer = nullptr;
+    QMutex frameMutex;
+    QWaitCondition frameReady;
+    QImage pendingFrame;
+    qint64 pendingTimestamp = 0;
+    qint64 pendingGrabMs = 0;
+    int droppedFrames = 0;
+
+    QThread *encoder = nullptr;
+    QTemporaryFile *spill = nullptr; // 只由抓取线程写入
+    QMutex mutex;
+    QWaitCondition wake;
+    QList<Delta> queue;
+    qint64 queuedBytes = 0;
+    int spilledPending = 0; // 还没被编码线程读回的溢出帧
+    bool stopping = false;
+    qint64 endTimestamp = 0;
+    bool ok = false;
+    QString error;
+
+    void grabLoop();
+    void compareLoop();
+    void grabOnGuiThread();
+    void finishGrabbing();
+    QImage grabRegion() const;
+    void addFrame(const QImage &frame, qint64 timestamp, qint64 grabMs);
+    void enqueue(Delta delta);
+    void run();
+    QImage loadSpilled(QFile &file, const Delta &delta);
+};
+
+#endif // REGIONRECORDER_H
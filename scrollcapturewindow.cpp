@@ -0,0 +1,69 @@
+#include "scrollcapturewindow.h"
+#include "capturepanel.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QLabel>
+#include <QPushButton>
+#include <QHBoxLayout>
+#include <QDebug>
+
+ScrollCaptureWindow::ScrollCaptureWindow(const QRect &region, QWidget *parent)
+    : QWidget(parent), region(region)
+{
+    setWindowFlags(Qt::Tool | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    statusLabel = new QLabel("请滚动选区内的页面", this);
+    statusLabel->setMinimumWidth(160); // 面板摆好后不再改变大小，不会伸进抓取区域
+    QPushButton *doneButton = new QPushButton("完成", this);
+    QPushButton *cancelButton = new QPushButton("取消", this);
+    QHBoxLayout *layout = new QHBoxLayout(this);
+    layout->addWidget(statusLabel);
+    layout->addWidget(doneButton);
+    layout->addWidget(cancelButton);
+    layout->setContentsMargins(5, 5, 5, 5);
+    setLayout(layout);
+
+    connect(doneButton, &QPushButton::clicked, this, [this]() {
+        grabTimer.stop();
+        grabFrame(); // 补上最后一次滚动
+        qDebug() << "ScrollCaptureWindow: Stitched" << frames << "frames," << stitcher.height() << "rows, grab+stitch"
+                 << (frames > 0 ? grabMs / frames : 0) << "ms per frame";
+        emit finished(stitcher.result());
+        close();
+    });
+    connect(cancelButton, &QPushButton::clicked, this, [this]() {
+        grabTimer.stop();
+        emit canceled();
+        close();
+    });
+
+    // 约 25 帧每秒，滚轮一格通常只滚动几十行，相邻两帧之间有足够的重叠
+    grabTimer.setInterval(40);
+    connect(&grabTimer, &QTimer::timeout, this, &ScrollCaptureWindow::grabFrame);
+    adjustSize();
+    grabRegion = CapturePanel::place(this, region);
+    show();
+    grabFrame();
+    grabTimer.start();
+}
+
+void ScrollCaptureWindow::grabFrame()
+{
+    QScreen *screen = QGuiApplication::screenAt(region.center());
+    if (!screen) {
+        screen = QGuiApplication::primaryScreen();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QRect local = grabRegion.translated(-screen->geometry().topLeft());
+    QImage frame = screen->grabWindow(0, local.x(), local.y(), local.width(), local.height()).toImage();
+    if (frame.isNull()) {
+        return;
+    }
+    if (stitcher.append(frame)) {
+        statusLabel->setText(QString("已拼接 %1 像素").arg(stitcher.height()));
+    }
+    grabMs += timer.elapsed();
+    ++frames;
+}
@@ -0,0 +1,35 @@
+#ifndef SCROLLCAPTUREWINDOW_H
+#define SCROLLCAPTUREWINDOW_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "scrollstitcher.h"
+
+class QLabel;
+
+// 滚动截图的控制面板：尽量放在选区外侧，定时抓取选区并交给 ScrollStitcher 拼接，
+// 用户在选区内滚动页面，完成后发出拼接好的长图
+class ScrollCaptureWindow : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit ScrollCaptureWindow(const QRect &region, QWidget *parent = nullptr);
+
+signals:
+    void finished(const QImage &image);
+    void canceled();
+
+private:
+    QRect region;     // 全局坐标
+    QRect grabRegion; // 实际抓取的区域，面板只能放在选区内时让出面板所在的行
+    ScrollStitcher stitcher;
+    QTimer grabTimer;
+    QLabel *statusLabel;
+    int frames = 0;
+    qint64 grabMs = 0;
+
+    void grabFrame();
+};
+
+#endif // SCROLLCAPTUREWINDOW_H
@@ -0,0 +1,179 @@
+#include "scrollstitcher.h"
+#include <QHash>
+#include <QDebug>
+#include <cstring>
+#include <algorithm>
+
+static const int MinVotes = 8;
+
+QVector<quint64> ScrollStitcher::rowHashes(const QImage &frame)
+{
+    QVector<quint64> hashes(frame.height());
+    const int bytes = frame.width() * 4;
+    for (int y = 0; y < frame.height(); ++y) {
+        hashes[y] = qHashBits(frame.constScanLine(y), size_t(bytes), 0);
+    }
+    return hashes;
+}
+
+// 返回新帧相对前一帧向上滚动的行数：正数为向下翻页（新内容从底部滚入），负数为往回滚，
+// 0 表示没有滚动，NoOverlap 表示两帧之间找不到重叠
+int ScrollStitcher::findScroll(const QImage &frame, const QVector<quint64> &hashes) const
+{
+    const int h = frame.height();
+    // 只用在前一帧中唯一的行投票，空白行和重复的行不参与
+    QHash<quint64, int> unique;
+    QHash<quint64, int> seen;
+    for (int y = 0; y < h; ++y) {
+        if (seen[previousHashes[y]]++ == 0) {
+            unique.insert(previousHashes[y], y);
+        } else {
+            unique.remove(previousHashes[y]);
+        }
+    }
+    QHash<int, int> votes;
+    for (int y = 0; y < h; ++y) {
+        auto it = unique.constFind(hashes[y]);
+        if (it != unique.constEnd() && it.value() != y) {
+            ++votes[it.value() - y];
+        }
+    }
+
+    // 从得票最多的滚动量开始核对，重叠区的每一行都要逐字节相同（底部固定行除外）
+    QList<QPair<int, int>> candidates;
+    for (auto it = votes.constBegin(); it != votes.constEnd(); ++it) {
+        if (it.value() >= MinVotes) {
+            candidates.append({it.value(), it.key()});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const QPair<int, int> &a, const QPair<int, int> &b) {
+        return a.first > b.first;
+    });
+    const int bytes = frame.width() * 4;
+    for (const auto &candidate : std::as_const(candidates)) {
+        int dy = candidate.second;
+        int mismatches = 0;
+        for (int y = qMax(0, -dy); y < qMin(h, h - dy); ++y) {
+            if (hashes[y] != previousHashes[y + dy]
+                || memcmp(frame.constScanLine(y), previous.constScanLine(y + dy), bytes) != 0) {
+                ++mismatches;
+            }
+        }
+        // 允许固定的页眉页脚等少量行不匹配
+        if (mismatches * 5 <= h - qAbs(dy)) {
+            return dy;
+        }
+    }
+    // 没有滚动时大部分行留在原位，只有光标闪烁、悬停效果之类的局部变化
+    int unchanged = 0;
+    for (int y = 0; y < h; ++y) {
+        unchanged += hashes[y] == previousHashes[y];
+    }
+    return unchanged * 5 >= h * 4 ? 0 : NoOverlap;
+}
+
+// 与前一帧没有重叠时，判断这一帧是否全是没拼接过的内容。
+// 只看在帧内唯一的行（空白行、重复的表格线不能说明什么），其中至多五分之一（固定的页眉页脚）在已拼接的行中出现过才算；
+// 否则可能是往回滚到了更早的位置，宁可丢掉这一帧也不重复拼接
+bool ScrollStitcher::isUnseen(const QVector<quint64> &hashes) const
+{
+    QHash<quint64, int> counts;
+    for (quint64 hash : hashes) {
+        ++counts[hash];
+    }
+    int distinct = 0;
+    int known = 0;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        if (it.value() == 1) {
+            ++distinct;
+            known += stitchedRows.contains(it.key());
+        }
+    }
+    return distinct >= MinVotes && known * 5 <= distinct;
+}
+
+bool ScrollStitcher::append(const QImage &source)
+{
+    QImage frame = source.convertToFormat(QImage::Format_RGB32);
+    QVector<quint64> hashes = rowHashes(frame);
+    if (previous.isNull()) {
+        width = frame.width();
+        appendRows(frame, hashes, 0, frame.height());
+        previous = frame;
+        previousHashes = hashes;
+        return true;
+    }
+    if (frame.size() != previous.size()) {
+        return false;
+    }
+
+    const int h = frame.height();
+    int dy = findScroll(frame, hashes);
+    if (dy == 0) {
+        return false;
+    }
+    if (dy == NoOverlap) {
+        if (!isUnseen(hashes)) {
+            qDebug() << "ScrollStitcher: No overlap with the previous frame and content was seen before, frame ignored";
+            return false;
+        }
+        // 滚得太快，两帧之间没有重叠，而且前一帧的内容确实已经不在画面里：整帧接上，中间会缺一段
+        qDebug() << "ScrollStitcher: No overlap found, appending whole frame";
+        dy = h;
+    }
+    if (dy < 0) {
+        // 往回滚：这些内容已经拼接过。前一帧保持为拼接到的最远位置，再滚下来时从那里继续
+        qDebug() << "ScrollStitcher: Scrolled back by" << -dy << "rows, frame ignored";
+        return false;
+    }
+
+    // 第一次滚动时确定底部固定行：与前一帧同一位置完全相同、不随内容滚动的行（状态栏等）。
+    // 它们已经作为第一帧的一部分进入结果，移到末尾单独保存
+    if (!footerDecided && dy < h) {
+        footerDecided = true;
+        int fixedBottom = 0;
+        while (fixedBottom < qMin(h - dy, h / 4) && hashes[h - 1 - fixedBottom] == previousHashes[h - 1 - fixedBottom]) {
+            ++fixedBottom;
+        }
+        if (fixedBottom > 0) {
+            rows -= fixedBottom;
+            footer = frame.copy(0, h - fixedBottom, frame.width(), fixedBottom);
+        }
+    }
+    int count = qMin(dy, h - footer.height());
+    appendRows(frame, hashes, h - footer.height() - count, count);
+
+    previous = frame;
+    previousHashes = hashes;
+    return true;
+}
+
+void ScrollStitcher::appendRows(const QImage &frame, const QVector<quint64> &hashes, int first, int count)
+{
+    const int bytes = width * 4;
+    for (int i = 0; i < count; ++i) {
+        stitchedRows.insert(hashes[first + i]);
+        int tile = rows / TileRows;
+        if (tile >= tiles.size()) {
+            tiles.append(QImage(width, TileRows, QImage::Format_RGB32));
+        }
+        memcpy(tiles[tile].scanLine(rows % TileRows), frame.constScanLine(first + i), bytes);
+        ++rows;
+    }
+}
+
+QImage ScrollStitcher::result() const
+{
+    if (rows == 0) {
+        return QImage();
+    }
+    QImage image(width, height(), QImage::Format_RGB32);
+    const int bytes = width * 4;
+    for (int y = 0; y < rows; ++y) {
+        memcpy(image.scanLine(y), tiles[y / TileRows].constScanLine(y % TileRows), bytes);
+    }
+    for (int y = 0; y < footer.height(); ++y) {
+        memcpy(image.scanLine(rows + y), footer.constScanLine(y), bytes);
+    }
+    return image;
+}
@@ -0,0 +1,40 @@
+#ifndef SCROLLSTITCHER_H
+#define SCROLLSTITCHER_H
+
+#include <QImage>
+#include <QList>
+#include <QVector>
+#include <QSet>
+#include <climits>
+
+// 滚动截图的拼接器：依次传入同一屏幕区域的各帧，只把新滚入的行追加到结果中。
+// 每帧先计算逐行哈希，用前一帧中唯一的行哈希为每个候选滚动量投票，
+// 得票最多的滚动量再用 memcmp 逐行核对重叠部分；底部不随内容滚动的固定行（状态栏等）单独保存，最后才接到末尾。
+// 往回滚动的帧直接忽略；与前一帧没有重叠时，只有帧内容从未拼接过才整帧接上。
+// 结果按固定行数的分块保存，内存只随不重复的内容增长。
+class ScrollStitcher {
+public:
+    bool append(const QImage &frame); // 返回 false 表示该帧没有新内容
+    int height() const { return rows + footer.height(); }
+    QImage result() const;
+
+private:
+    static const int TileRows = 256;
+    static const int NoOverlap = INT_MIN;
+
+    int width = 0;
+    int rows = 0;
+    QList<QImage> tiles;
+    QImage footer;          // 底部固定行
+    bool footerDecided = false;
+    QImage previous;
+    QVector<quint64> previousHashes;
+    QSet<quint64> stitchedRows; // 已进入结果的所有行的哈希
+
+    void appendRows(const QImage &frame, const QVector<quint64> &hashes, int first, int count);
+    static QVector<quint64> rowHashes(const QImage &frame);
+    int findScroll(const QImage &frame, const QVector<quint64> &hashes) const;
+    bool isUnseen(const QVector<quint64> &hashes) const;
+};
+
+#endif // SCROLLSTITCHER_H
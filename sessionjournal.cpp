@@ -0,0 +1,349 @@
+#include "sessionjournal.h"
+#include <QThread>
+#include <QLockFile>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QCoreApplication>
+#include <QtEndian>
+#include <QDebug>
+
+static const char Magic[8] = {'S', 'S', 'H', 'O', 'T', 'J', 'N', 'L'};
+static const int RecordHeaderSize = 6;           // 长度 (4) + 校验和 (2)
+static const int CompactAfterRecords = 512;
+static const qint64 CompactAfterBytes = 4 * 1024 * 1024;
+
+static QString captureFile(const QString &dir) { return dir + "/capture.sshot"; }
+static QString journalFile(const QString &dir) { return dir + "/journal.bin"; }
+static QString lockFile(const QString &dir) { return dir + "/session.lock"; }
+
+SessionJournal::SessionJournal(const QImage &capture, const QRect &viewport)
+{
+    QString name = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss_zzz")
+                   + QString("_%1").arg(QCoreApplication::applicationPid());
+    dir = sessionsRoot() + "/" + name;
+    QDir().mkpath(dir);
+    lock = new QLockFile(lockFile(dir));
+    lock->tryLock(0);
+
+    // 截图只写一次；写线程先写截图再开始追加日志
+    pendingCapture = capture;
+    writer = QThread::create([this, viewport]() {
+        run(viewport);
+    });
+    writer->start(QThread::LowPriority);
+}
+
+SessionJournal::~SessionJournal()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+    }
+    wake.wakeOne();
+    writer->wait();
+    delete writer;
+
+    // 正常结束，会话不再需要恢复
+    lock->unlock();
+    delete lock;
+    remove(dir);
+}
+
+QString SessionJournal::sessionsRoot()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/sessions";
+}
+
+void SessionJournal::append(Op op, const QByteArray &payload)
+{
+    QByteArray record;
+    record.reserve(payload.size() + 1);
+    record.append(char(op));
+    record.append(payload);
+    enqueue(record);
+}
+
+void SessionJournal::enqueue(const QByteArray &record)
+{
+    {
+        QMutexLocker locker(&mutex);
+        pending.append(record);
+    }
+    wake.wakeOne();
+}
+
+void SessionJournal::setCapture(const QImage &capture)
+{
+    {
+        QMutexLocker locker(&mutex);
+        pendingCapture = capture;
+    }
+    wake.wakeOne();
+}
+
+void SessionJournal::reset(const ProjectData &state)
+{
+    enqueue(encodeSnapshot(state));
+}
+
+void SessionJournal::addShape(const Shape &shape)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << shape;
+    append(AddShape, payload);
+}
+
+void SessionJournal::updateShape(int index, const Shape &shape)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << qint32(index) << shape;
+    append(UpdateShape, payload);
+}
+
+void SessionJournal::removeLastShape()
+{
+    append(RemoveLastShape, QByteArray());
+}
+
+void SessionJournal::setViewport(const QRect &viewport)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << viewport;
+    append(SetViewport, payload);
+}
+
+void SessionJournal::setSlices(const QList<ExportSlice> &slices)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << slices;
+    append(SetSlices, payload);
+}
+
+void SessionJournal::setNoteNumber(int noteNumber)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << qint32(noteNumber);
+    append(SetNoteNumber, payload);
+}
+
+// 记录格式：载荷长度 (小端 32 位)、载荷的 CRC-16、载荷（首字节为操作类型）。
+// 崩溃时最后一条记录可能只写了一半，重放时在第一条不完整或校验失败的记录处停止。
+QByteArray SessionJournal::encodeRecord(const QByteArray &payload)
+{
+    QByteArray record(RecordHeaderSize, 0);
+    uchar *header = reinterpret_cast<uchar *>(record.data());
+    qToLittleEndian(quint32(payload.size()), header);
+    qToLittleEndian(quint16(qChecksum(payload)), header + 4);
+    record.append(payload);
+    return record;
+}
+
+QByteArray SessionJournal::encodeSnapshot(const ProjectData &state)
+{
+    QByteArray payload;
+    payload.append(char(Snapshot));
+    QDataStream stream(&payload, QIODevice::WriteOnly | QIODevice::Append);
+    stream.setVersion(ProjectFile::StreamVersion);
+    stream << state.viewport << qint32(state.noteNumber) << state.shapes << state.slices;
+    return payload;
+}
+
+bool SessionJournal::applyRecord(const QByteArray &payload, ProjectData &state)
+{
+    if (payload.isEmpty()) {
+        return false;
+    }
+    QDataStream stream(payload.mid(1));
+    stream.setVersion(ProjectFile::StreamVersion);
+    qint32 number;
+    switch (Op(quint8(payload.at(0)))) {
+    case Snapshot:
+        state.shapes.clear();
+        state.slices.clear();
+        stream >> state.viewport >> number >> state.shapes >> state.slices;
+        state.noteNumber = number;
+        break;
+    case AddShape: {
+        Shape shape;
+        stream >> shape;
+        state.shapes.append(shape);
+        break;
+    }
+    case UpdateShape: {
+        Shape shape;
+        stream >> number >> shape;
+        if (number < 0 || number >= state.shapes.size()) {
+            return false;
+        }
+        state.shapes[number] = shape;
+        break;
+    }
+    case RemoveLastShape:
+        if (!state.shapes.isEmpty()) {
+            state.shapes.removeLast();
+        }
+        break;
+    case SetViewport:
+        stream >> state.viewport;
+        break;
+    case SetSlices:
+        state.slices.clear();
+        stream >> state.slices;
+        break;
+    case SetNoteNumber:
+        stream >> number;
+        state.noteNumber = number;
+        break;
+    default:
+        return false;
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+void SessionJournal::run(const QRect &viewport)
+{
+    ProjectData state;
+    state.viewport = viewport;
+
+    QFile journal(journalFile(dir));
+    auto openJournal = [&journal]() {
+        return journal.open(QIODevice::WriteOnly | QIODevice::Append);
+    };
+    if (openJournal() && journal.size() == 0) {
+        journal.write(Magic, sizeof(Magic));
+        journal.flush();
+    }
+
+    int recordsSinceCompaction = 0;
+    QImage unsaved; // 还没写出的截图，等到有编辑需要恢复时才写
+    forever {
+        QList<QByteArray> batch;
+        {
+            QMutexLocker locker(&mutex);
+            while (pending.isEmpty() && pendingCapture.isNull() && !stopping) {
+                wake.wait(&mutex);
+            }
+            if (pending.isEmpty() && pendingCapture.isNull()) {
+                return;
+            }
+            batch.swap(pending);
+            if (!pendingCapture.isNull()) {
+                unsaved = pendingCapture;
+                pendingCapture = QImage();
+            }
+        }
+
+        // 同一批记录合并成一次写入；不做 fsync，进程崩溃时数据已在系统缓存中
+        QByteArray block;
+        for (const QByteArray &payload : batch) {
+            applyRecord(payload, state);
+            block.append(encodeRecord(payload));
+        }
+
+        // 没有形状和切片的会话恢复出来也只是一张截图，不值得每次都写几十 MB；
+        // 第一次有编辑时才写截图，并用 QOI 压缩，先于日志落盘，恢复时总能找到截图
+        if (!unsaved.isNull() && (!state.shapes.isEmpty() || !state.slices.isEmpty())) {
+            ProjectData base;
+            base.capture = unsaved;
+            base.viewport = state.viewport;
+            if (!ProjectFile::save(captureFile(dir), base, ProjectFile::Qoi)) {
+                qDebug() << "SessionJournal: Failed to write capture:" << dir;
+            }
+            unsaved = QImage();
+        }
+        if (batch.isEmpty()) {
+            continue;
+        }
+
+        journal.write(block);
+        journal.flush();
+        recordsSinceCompaction += batch.size();
+
+        if (recordsSinceCompaction >= CompactAfterRecords || journal.size() >= CompactAfterBytes) {
+            // 压缩：写一个只含快照的新日志，再原子地替换旧日志
+            journal.close();
+            QSaveFile compacted(journalFile(dir));
+            if (compacted.open(QIODevice::WriteOnly)) {
+                compacted.write(Magic, sizeof(Magic));
+                compacted.write(encodeRecord(encodeSnapshot(state)));
+                compacted.commit();
+            }
+            openJournal();
+            qDebug() << "SessionJournal: Compacted" << recordsSinceCompaction << "records to" << journal.size() << "bytes";
+            recordsSinceCompaction = 0;
+        }
+    }
+}
+
+QStringList SessionJournal::pendingSessions()
+{
+    QStringList sessions;
+    QDir root(sessionsRoot());
+    const QStringList names = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name | QDir::Reversed);
+    for (const QString &name : names) {
+        QString path = root.filePath(name);
+        if (!QFile::exists(captureFile(path))) {
+            continue;
+        }
+        // 只看持有锁的进程是否还在运行，运行中的其它实例的会话不算残留
+        QLockFile probe(lockFile(path));
+        probe.setStaleLockTime(0);
+        if (probe.tryLock(0)) {
+            probe.unlock();
+            sessions.append(path);
+        }
+    }
+    return sessions;
+}
+
+bool SessionJournal::restore(const QString &sessionDir, ProjectData &data)
+{
+    if (!ProjectFile::load(captureFile(sessionDir), data)) {
+        return false;
+    }
+    QFile journal(journalFile(sessionDir));
+    if (!journal.open(QIODevice::ReadOnly)) {
+        return true;
+    }
+    QByteArray bytes = journal.readAll();
+    if (!bytes.startsWith(QByteArray(Magic, sizeof(Magic)))) {
+        return true;
+    }
+
+    int records = 0;
+    qsizetype pos = sizeof(Magic);
+    while (pos + RecordHeaderSize <= bytes.size()) {
+        const uchar *header = reinterpret_cast<const uchar *>(bytes.constData() + pos);
+        quint32 length = qFromLittleEndian<quint32>(header);
+        quint16 checksum = qFromLittleEndian<quint16>(header + 4);
+        if (pos + RecordHeaderSize + qsizetype(length) > bytes.size()) {
+            break;
+        }
+        QByteArray payload = bytes.mid(pos + RecordHeaderSize, length);
+        if (quint16(qChecksum(payload)) != checksum || !applyRecord(payload, data)) {
+            break;
+        }
+        pos += RecordHeaderSize + length;
+        ++records;
+    }
+    qDebug() << "SessionJournal: Restored" << sessionDir << ", records:" << records << ", shapes:" << data.shapes.size();
+    return true;
+}
+
+void SessionJournal::remove(const QString &sessionDir)
+{
+    QDir(sessionDir).removeRecursively();
+}
@@ -0,0 +1,60 @@
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include "projectfile.h"
+
+class QThread;
+class QLockFile;
+
+// 编辑会话的追加写日志，用于崩溃后恢复。
+// 会话目录中保存一次原始截图 (capture.sshot，QOI 压缩，第一次有形状或切片时才写) 和形状操作日志 (journal.bin)；
+// 编辑器线程只把编码好的小记录放进队列，由后台写线程批量追加到文件末尾。
+// 写线程同时在内存中重放记录，记录数或文件过大时用一条快照记录重写日志（压缩）。
+// 正常结束时删除会话目录，启动时残留且未被其它进程锁定的目录就是可恢复的会话。
+class SessionJournal {
+public:
+    SessionJournal(const QImage &capture, const QRect &viewport); // capture 为空时等 setCapture 再写
+    ~SessionJournal();
+
+    void setCapture(const QImage &capture); // 只保留最新的一张，尚未写出的旧截图直接丢弃
+
+    void reset(const ProjectData &state);  // 用完整状态替换日志内容，截图除外
+    void addShape(const Shape &shape);
+    void updateShape(int index, const Shape &shape);
+    void removeLastShape();
+    void setViewport(const QRect &viewport);
+    void setSlices(const QList<ExportSlice> &slices);
+    void setNoteNumber(int noteNumber);
+
+    static QStringList pendingSessions();  // 最新的在前
+    static bool restore(const QString &sessionDir, ProjectData &data);
+    static void remove(const QString &sessionDir);
+
+private:
+    enum Op : quint8 { Snapshot = 1, AddShape, UpdateShape, RemoveLastShape, SetViewport, SetSlices, SetNoteNumber };
+
+    QString dir;
+    QLockFile *lock;
+    QThread *writer;
+    QMutex mutex;
+    QWaitCondition wake;
+    QList<QByteArray> pending;
+    QImage pendingCapture;
+    bool stopping = false;
+
+    void append(Op op, const QByteArray &payload);
+    void enqueue(const QByteArray &record);
+    void run(const QRect &viewport);
+
+    static QString sessionsRoot();
+    static QByteArray encodeRecord(const QByteArray &payload);
+    static QByteArray encodeSnapshot(const ProjectData &state);
+    static bool applyRecord(const QByteArray &payload, ProjectData &state);
+};
+
+#endif // SESSIONJOURNAL_H
@@ -9,7 +9,7 @@ enum ShapeType { Rectangle, Ellipse, Text, Pen, Mask, NumberedNote, Arrow }; //
 
 struct Shape {
     ShapeType type;
-    QRect rect; // 用于矩形、圆形、文本、序号笔记、箭头的位置和大小
+    QRect rect; // 用于矩形、圆形、文本、序号笔记、箭头的位置和大小，以及没有路径点的矩形遮罩
     QList<QPoint> points; // 用于画笔的路径（箭头也可以用）
     QString text; // 用于文本和序号笔记的内容
     int width; // 边框或字体大小
@@ -0,0 +1,103 @@
+#include "shaperenderer.h"
+#include <QPainterPath>
+#include <QFontMetrics>
+#include <cmath>
+
+void ShapeRenderer::draw(QPainter &painter, const Shape &shape)
+{
+    painter.setPen(QPen(shape.color, shape.width));
+    painter.setBrush(Qt::NoBrush);
+    if (shape.type == Rectangle) {
+        painter.drawRect(shape.rect);
+    } else if (shape.type == Ellipse) {
+        painter.drawEllipse(shape.rect);
+    } else if (shape.type == Text) {
+        painter.setFont(QFont("Arial", shape.width));
+        painter.setPen(shape.color);
+        painter.drawText(shape.rect, Qt::AlignLeft | Qt::TextWordWrap, shape.text);
+    } else if (shape.type == NumberedNote) {
+        int fixedFontSize = 16;
+        painter.setFont(QFont("Arial", fixedFontSize));
+        int boxSize = 32;
+        QPoint topLeft = shape.rect.topLeft();
+        painter.setBrush(Qt::red);
+        painter.setPen(Qt::NoPen);
+        QPoint center = topLeft + QPoint(boxSize / 2, boxSize / 2);
+        painter.drawEllipse(center, boxSize / 2, boxSize / 2);
+        QFontMetrics fmSeq(QFont("Arial", fixedFontSize));
+        QString numberText = QString::number(shape.number);
+        int numberWidth = fmSeq.horizontalAdvance(numberText);
+        int textHeight = fmSeq.height();
+        painter.setPen(Qt::white);
+        int verticalOffset = textHeight / 4;
+        QPoint textPos = center - QPoint(numberWidth / 2, -verticalOffset);
+        painter.drawText(textPos, numberText);
+
+        if (!shape.bubbleRect.isNull()) {
+            painter.setBrush(shape.bubbleColor);
+            painter.setPen(QPen(shape.bubbleBorderColor, 1));
+            QPainterPath path;
+            int radius = 5;
+            path.addRoundedRect(shape.bubbleRect, radius, radius);
+            painter.drawPath(path);
+
+            painter.setFont(QFont("Arial", shape.width));
+            painter.setPen(shape.color);
+            QString contentText = shape.text.mid(shape.text.indexOf(". ") + 2);
+            painter.drawText(shape.bubbleRect, Qt::AlignCenter | Qt::TextWordWrap, contentText);
+        }
+    } else if (shape.type == Mask && shape.points.isEmpty()) {
+        painter.fillRect(shape.rect, shape.color); // 矩形遮罩，由批量打码生成
+    } else if (shape.type == Pen || shape.type == Mask) {
+        painter.setPen(QPen(shape.color, shape.width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+        painter.setBrush(Qt::NoBrush);
+        for (int i = 1; i < shape.points.size(); ++i) {
+            painter.drawLine(shape.points[i - 1], shape.points[i]);
+        }
+    } else if (shape.type == Arrow) {
+        painter.setPen(QPen(shape.color, shape.width, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+        if (shape.points.size() == 2) {
+            QPoint start = shape.points[0];
+            QPoint end = shape.points[1];
+            painter.drawLine(start, end);
+            QPointF arrowP1, arrowP2;
+            arrowHead(shape, arrowP1, arrowP2);
+            painter.drawLine(end, arrowP1);
+            painter.drawLine(end, arrowP2);
+        }
+    }
+}
+
+void ShapeRenderer::drawAll(QPainter &painter, const QList<Shape> &shapes)
+{
+    for (const Shape &shape : shapes) {
+        draw(painter, shape);
+    }
+}
+
+void ShapeRenderer::arrowHead(const Shape &shape, QPointF &wing1, QPointF &wing2)
+{
+    QPoint start = shape.points.value(0);
+    QPoint end = shape.points.value(1);
+    double angle = atan2(end.y() - start.y(), end.x() - start.x());
+    int arrowSize = shape.width * 3;
+    wing1 = end - QPointF(cos(angle + M_PI / 6) * arrowSize, sin(angle + M_PI / 6) * arrowSize);
+    wing2 = end - QPointF(cos(angle - M_PI / 6) * arrowSize, sin(angle - M_PI / 6) * arrowSize);
+}
+
+QRect ShapeRenderer::bounds(const Shape &shape)
+{
+    QRect result = shape.rect.normalized();
+    if (shape.type == NumberedNote) {
+        result |= QRect(shape.rect.topLeft(), QSize(32, 32));
+        if (!shape.bubbleRect.isNull()) {
+            result |= shape.bubbleRect.normalized();
+        }
+    }
+    for (const QPoint &point : shape.points) {
+        result |= QRect(point, QSize(1, 1));
+    }
+    // 箭头两翼长度为线宽的 3 倍，再留出抗锯齿的余量
+    int margin = shape.width * 3 + 2;
+    return result.adjusted(-margin, -margin, margin, margin);
+}
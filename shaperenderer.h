@@ -0,0 +1,17 @@
+#ifndef SHAPERENDERER_H
+#define SHAPERENDERER_H
+
+#include <QPainter>
+#include <QList>
+#include "shape.h"
+
+// 形状绘制逻辑，不依赖任何窗口，可以在导出线程里对 QImage 绘制
+class ShapeRenderer {
+public:
+    static void draw(QPainter &painter, const Shape &shape);
+    static void drawAll(QPainter &painter, const QList<Shape> &shapes);
+    static QRect bounds(const Shape &shape); // 绘制可能触及的范围（含线宽和箭头），原始截图坐标
+    static void arrowHead(const Shape &shape, QPointF &wing1, QPointF &wing2); // 箭头两翼端点
+};
+
+#endif // SHAPERENDERER_H
@@ -19,7 +19,28 @@ SizeDisplayWindow::SizeDisplayWindow(QWidget *parent)
 
 void SizeDisplayWindow::setSizeText(const QString &text)
 {
+    sizeText = text;
+    updateLabel();
+}
+
+void SizeDisplayWindow::setEstimatedBytes(qint64 bytes)
+{
+    estimatedBytes = bytes;
+    updateLabel();
+}
+
+void SizeDisplayWindow::updateLabel()
+{
+    QString text = sizeText;
+    if (estimatedBytes >= 0) {
+        if (estimatedBytes >= 1024 * 1024) {
+            text += QString(" ≈ %1 MB").arg(estimatedBytes / (1024.0 * 1024.0), 0, 'f', 1);
+        } else {
+            text += QString(" ≈ %1 KB").arg(qMax<qint64>(1, (estimatedBytes + 512) / 1024));
+        }
+    }
     sizeLabel->setText(text);
+    adjustSize();
 }
 
 void SizeDisplayWindow::paintEvent(QPaintEvent *event)
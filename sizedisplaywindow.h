@@ -10,12 +10,17 @@ class SizeDisplayWindow : public QWidget {
 public:
     explicit SizeDisplayWindow(QWidget *parent = nullptr);
     void setSizeText(const QString &text);
+    void setEstimatedBytes(qint64 bytes); // 小于 0 时不显示估算体积
 
 protected:
     void paintEvent(QPaintEvent *event) override;
 
 private:
     QLabel *sizeLabel;
+    QString sizeText;
+    qint64 estimatedBytes = -1;
+
+    void updateLabel();
 };
 
 #endif // SIZEDISPLAYWINDOW_H
@@ -0,0 +1,172 @@
+#include "sizeestimator.h"
+#include "shaperenderer.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QDebug>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static const int TileSize = 128;
+static const int DebounceMs = 120;
+static const int MaxCachedTiles = 8192;
+static const int PngOverhead = 57; // 签名 + IHDR + IEND + 一个 IDAT 的头尾 + zlib 头尾
+
+static uint hashShape(const Shape &shape)
+{
+    uint h = qHash(int(shape.type));
+    const int values[] = {shape.rect.x(), shape.rect.y(), shape.rect.width(), shape.rect.height(),
+                          shape.width, shape.number, int(shape.color.rgba()),
+                          shape.bubbleRect.x(), shape.bubbleRect.y(), shape.bubbleRect.width(), shape.bubbleRect.height(),
+                          int(shape.bubbleColor.rgba()), int(shape.bubbleBorderColor.rgba())};
+    for (int value : values) {
+        h = qHash(value, h);
+    }
+    for (const QPoint &point : shape.points) {
+        h = qHash(point.x(), qHash(point.y(), h));
+    }
+    return qHash(shape.text, h);
+}
+
+// 与导出时“最快”档一致：Sub 过滤后整块 deflate
+static SizeEstimator::TileResult encodeTile(const SizeEstimator::TileJob &job)
+{
+    QImage tile = job.capture.copy(job.key.rect);
+    if (!job.shapes.isEmpty()) {
+        tile = tile.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QPainter painter(&tile);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(-job.key.rect.topLeft());
+        ShapeRenderer::drawAll(painter, job.shapes);
+        painter.end();
+    }
+    QImage rgb = tile.convertToFormat(QImage::Format_RGB888);
+
+    int rowBytes = rgb.width() * 3;
+    QByteArray filtered(rgb.height() * (rowBytes + 1), 0);
+    uchar *out = reinterpret_cast<uchar *>(filtered.data());
+    for (int y = 0; y < rgb.height(); ++y) {
+        const uchar *row = rgb.constScanLine(y);
+        *out++ = 1;
+        for (int i = 0; i < rowBytes; ++i) {
+            *out++ = uchar(row[i] - (i >= 3 ? row[i - 3] : 0));
+        }
+    }
+
+#ifdef HAVE_ZLIB
+    uLongf size = compressBound(uLong(filtered.size()));
+    QByteArray compressed(int(size), 0);
+    compress2(reinterpret_cast<Bytef *>(compressed.data()), &size,
+              reinterpret_cast<const Bytef *>(filtered.constData()), uLong(filtered.size()), 1);
+#else
+    // qCompress 使用 Qt 自带的 zlib，结果前面多 4 字节的原始长度
+    qint64 size = qCompress(filtered, 1).size() - 4;
+#endif
+
+    SizeEstimator::TileResult result;
+    result.key = job.key;
+    result.bytes = qint64(size) - 6; // 去掉每块各自的 zlib 头尾
+    return result;
+}
+
+bool operator==(const SizeEstimator::TileKey &a, const SizeEstimator::TileKey &b)
+{
+    return a.rect == b.rect && a.shapesHash == b.shapesHash;
+}
+
+size_t qHash(const SizeEstimator::TileKey &key, size_t seed)
+{
+    size_t h = qHash(key.rect.x(), seed);
+    h = qHash(key.rect.y(), h);
+    h = qHash(key.rect.width(), h);
+    h = qHash(key.rect.height(), h);
+    return qHash(key.shapesHash, h);
+}
+
+SizeEstimator::SizeEstimator(QObject *parent)
+    : QObject(parent)
+{
+    debounceTimer.setSingleShot(true);
+    debounceTimer.setInterval(DebounceMs);
+    connect(&debounceTimer, &QTimer::timeout, this, &SizeEstimator::startEstimate);
+    connect(&watcher, &QFutureWatcher<TileResult>::finished, this, &SizeEstimator::finishEstimate);
+}
+
+void SizeEstimator::setCapture(const QImage &image)
+{
+    capture = image;
+    cache.clear();
+}
+
+void SizeEstimator::update(const QRect &viewport, const QList<Shape> &shapes)
+{
+    this->viewport = viewport;
+    this->shapes = shapes;
+    debounceTimer.start();
+}
+
+void SizeEstimator::startEstimate()
+{
+    if (watcher.isRunning()) {
+        // 上一批完成后会按最新状态重算，已压缩的块都会进入缓存
+        return;
+    }
+    QRect area = viewport & capture.rect();
+    if (area.isEmpty()) {
+        return;
+    }
+
+    QList<QRect> shapeBounds;
+    QList<uint> shapeHashes;
+    for (const Shape &shape : shapes) {
+        shapeBounds.append(ShapeRenderer::bounds(shape));
+        shapeHashes.append(hashShape(shape));
+    }
+
+    // 网格对齐到原始截图坐标，拖动选区时内部的整块都能命中缓存
+    qint64 knownBytes = 0;
+    QList<TileJob> jobs;
+    int firstX = area.left() / TileSize * TileSize;
+    int firstY = area.top() / TileSize * TileSize;
+    for (int y = firstY; y <= area.bottom(); y += TileSize) {
+        for (int x = firstX; x <= area.right(); x += TileSize) {
+            TileJob job;
+            job.key.rect = QRect(x, y, TileSize, TileSize) & area;
+            job.key.shapesHash = 0;
+            for (int i = 0; i < shapes.size(); ++i) {
+                if (shapeBounds[i].intersects(job.key.rect)) {
+                    job.key.shapesHash = qHash(shapeHashes[i], job.key.shapesHash + 1);
+                    job.shapes.append(shapes[i]);
+                }
+            }
+            auto it = cache.constFind(job.key);
+            if (it != cache.constEnd()) {
+                knownBytes += it.value();
+            } else {
+                job.capture = capture;
+                jobs.append(job);
+            }
+        }
+    }
+
+    if (jobs.isEmpty()) {
+        emit estimateReady(knownBytes + PngOverhead);
+        return;
+    }
+    if (cache.size() + jobs.size() > MaxCachedTiles) {
+        cache.clear();
+    }
+    watcher.setFuture(QtConcurrent::mapped(std::move(jobs), encodeTile));
+}
+
+void SizeEstimator::finishEstimate()
+{
+    const QList<TileResult> results = watcher.future().results();
+    for (const TileResult &result : results) {
+        cache.insert(result.key, result.bytes);
+    }
+    qDebug() << "SizeEstimator: Encoded" << results.size() << "tiles, cached:" << cache.size();
+
+    // 重新汇总一次：状态没变时所有块都已在缓存中；期间有新的修改则只压缩新出现的块
+    startEstimate();
+}
@@ -0,0 +1,60 @@
+#ifndef SIZEESTIMATOR_H
+#define SIZEESTIMATOR_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QList>
+#include <QHash>
+#include <QTimer>
+#include <QFutureWatcher>
+#include "shape.h"
+
+// 编辑时估算导出 PNG 的体积。选区按原始截图上固定的网格切成小块，
+// 每块连同与它相交的形状单独压缩，结果按“块区域 + 形状指纹”缓存；
+// 选区移动或修改某个形状后，只有受影响的块需要在后台线程重新压缩。
+class SizeEstimator : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SizeEstimator(QObject *parent = nullptr);
+
+    void setCapture(const QImage &image);
+    void update(const QRect &viewport, const QList<Shape> &shapes); // 防抖，不会阻塞调用方
+
+signals:
+    void estimateReady(qint64 bytes);
+
+public:
+    struct TileKey {
+        QRect rect;      // 块在原始截图中的区域，已按选区裁剪
+        uint shapesHash; // 与该块相交的形状的指纹
+    };
+
+    struct TileJob {
+        TileKey key;
+        QImage capture;
+        QList<Shape> shapes;
+    };
+
+    struct TileResult {
+        TileKey key;
+        qint64 bytes = 0;
+    };
+
+private:
+    QImage capture;
+    QRect viewport;
+    QList<Shape> shapes;
+    QTimer debounceTimer;
+    QFutureWatcher<TileResult> watcher;
+    QHash<TileKey, qint64> cache;
+
+    void startEstimate();
+    void finishEstimate();
+};
+
+bool operator==(const SizeEstimator::TileKey &a, const SizeEstimator::TileKey &b);
+size_t qHash(const SizeEstimator::TileKey &key, size_t seed = 0);
+
+#endif // SIZEESTIMATOR_H
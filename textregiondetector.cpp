@@ -0,0 +1,153 @@
+#include "textregiondetector.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QHash>
+#include <QDebug>
+#include <numeric>
+
+static const int TileSize = 16;
+static const int BandTiles = 4;          // 每个行带包含的块行数
+static const int EdgeThreshold = 40;     // 相邻像素灰度差超过该值算强边缘
+static const int MaxStrokeRun = 6;       // 文字笔画两侧边缘的典型间距上限
+static const int MinRegionTiles = 3;
+
+// 单个块的文字得分，0 表示不像文字
+static float scoreTile(const uchar *gray, int stride, int w, int h)
+{
+    int horizontalEdges = 0;
+    int verticalEdges = 0;
+    int shortRuns = 0;
+    int runs = 0;
+    for (int y = 0; y < h; ++y) {
+        const uchar *row = gray + y * stride;
+        const uchar *next = y + 1 < h ? row + stride : row;
+        // 边缘计数是无分支的逐像素运算，编译器可以向量化
+        int rowEdges = 0;
+        for (int x = 0; x + 1 < w; ++x) {
+            rowEdges += qAbs(int(row[x + 1]) - int(row[x])) > EdgeThreshold;
+            verticalEdges += qAbs(int(next[x]) - int(row[x])) > EdgeThreshold;
+        }
+        horizontalEdges += rowEdges;
+        if (rowEdges < 2) {
+            continue;
+        }
+        // 笔画统计：同一行中相邻强边缘之间的距离
+        int last = -1;
+        for (int x = 0; x + 1 < w; ++x) {
+            if (qAbs(int(row[x + 1]) - int(row[x])) > EdgeThreshold) {
+                if (last >= 0) {
+                    ++runs;
+                    shortRuns += x - last <= MaxStrokeRun;
+                }
+                last = x;
+            }
+        }
+    }
+    const int pixels = w * h;
+    float horizontalDensity = float(horizontalEdges) / pixels;
+    float verticalDensity = float(verticalEdges) / pixels;
+    // 纯色区域边缘太少；照片和噪声边缘太多且笔画不规则
+    if (horizontalDensity < 0.04f || horizontalDensity > 0.45f || verticalDensity < 0.02f || runs < 4) {
+        return 0.0f;
+    }
+    float strokeRatio = float(shortRuns) / runs;
+    return strokeRatio > 0.5f ? strokeRatio * qMin(1.0f, horizontalDensity * 8) : 0.0f;
+}
+
+QList<QRect> TextRegionDetector::detect(const QImage &source, int budgetMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QImage image = source.convertToFormat(QImage::Format_Grayscale8);
+    const int width = image.width();
+    const int height = image.height();
+    const int tilesX = width / TileSize;
+    const int tilesY = height / TileSize;
+    if (tilesX == 0 || tilesY == 0) {
+        return {};
+    }
+
+    QVector<uchar> text(tilesX * tilesY, 0);
+    QList<int> bands;
+    for (int tileY = 0; tileY < tilesY; tileY += BandTiles) {
+        bands.append(tileY);
+    }
+    uchar *textData = text.data();
+    QAtomicInt skipped = 0;
+    QtConcurrent::blockingMap(bands, [&image, &timer, &skipped, textData, tilesX, tilesY, budgetMs](int firstTileY) {
+        if (timer.elapsed() > budgetMs) {
+            skipped.fetchAndAddRelaxed(1);
+            return;
+        }
+        for (int tileY = firstTileY; tileY < qMin(firstTileY + BandTiles, tilesY); ++tileY) {
+            for (int tileX = 0; tileX < tilesX; ++tileX) {
+                const uchar *tile = image.constScanLine(tileY * TileSize) + tileX * TileSize;
+                textData[tileY * tilesX + tileX] = scoreTile(tile, image.bytesPerLine(), TileSize, TileSize) > 0.0f;
+            }
+        }
+    });
+    qint64 scoreMs = timer.elapsed();
+
+    // 8 邻接合并，横向允许隔一个块（单词之间的空格）
+    QVector<int> parent(tilesX * tilesY);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto root = [&parent](int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    auto unite = [&parent, &root](int i, int j) {
+        int ri = root(i);
+        int rj = root(j);
+        if (ri != rj) {
+            parent[qMax(ri, rj)] = qMin(ri, rj);
+        }
+    };
+    for (int y = 0; y < tilesY; ++y) {
+        for (int x = 0; x < tilesX; ++x) {
+            int i = y * tilesX + x;
+            if (!text[i]) {
+                continue;
+            }
+            for (int dx = 1; dx <= 2 && x + dx < tilesX; ++dx) {
+                if (text[i + dx]) {
+                    unite(i, i + dx);
+                    break;
+                }
+            }
+            if (y + 1 < tilesY) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    if (x + dx >= 0 && x + dx < tilesX && text[i + tilesX + dx]) {
+                        unite(i, i + tilesX + dx);
+                    }
+                }
+            }
+        }
+    }
+
+    QHash<int, QRect> regions;
+    QHash<int, int> counts;
+    for (int i = 0; i < text.size(); ++i) {
+        if (!text[i]) {
+            continue;
+        }
+        QRect tile((i % tilesX) * TileSize, (i / tilesX) * TileSize, TileSize, TileSize);
+        int r = root(i);
+        QRect &region = regions[r];
+        region = region.isNull() ? tile : region.united(tile);
+        ++counts[r];
+    }
+    QList<QRect> result;
+    for (auto it = regions.constBegin(); it != regions.constEnd(); ++it) {
+        // 孤立的一两个块多半是图标或按钮边缘
+        if (counts.value(it.key()) >= MinRegionTiles) {
+            result.append(it.value());
+        }
+    }
+    qDebug() << "TextRegionDetector:" << width << "x" << height << ", regions:" << result.size()
+             << ", score:" << scoreMs << "ms, total:" << timer.elapsed() << "ms, skipped bands:" << skipped.loadRelaxed();
+    return result;
+}
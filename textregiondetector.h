@@ -0,0 +1,17 @@
+#ifndef TEXTREGIONDETECTOR_H
+#define TEXTREGIONDETECTOR_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+
+// 不做文字识别，只按图像统计找出“像文字”的区域，作为打码建议。
+// 截图按 16x16 的块打分：水平和竖直方向强边缘的密度都要在文字的典型范围内，
+// 且相邻边缘之间的游程（近似笔画宽度）要短；高分块按 8 邻接合并成候选矩形。
+// 行带在线程池中并行处理，超过时间预算后剩余的行带直接跳过，只返回已分析部分的结果。
+class TextRegionDetector {
+public:
+    static QList<QRect> detect(const QImage &image, int budgetMs = 150);
+};
+
+#endif // TEXTREGIONDETECTOR_H
@@ -5,12 +5,13 @@
 #include <QDebug>
 #include <QCoreApplication>
 #include <QPainter>
+#include <QActionGroup>
 
 ToolBarWindow::ToolBarWindow(EditWindow *editWindow, QWidget *parent)
     : QWidget(parent), editWindow(editWindow)
 {
     setWindowFlags(Qt::Tool | Qt::FramelessWindowHint);
-    setFixedWidth(420);
+    setFixedWidth(555);
     setupUI();
     adjustPosition();
     adjustHeight();
@@ -153,6 +154,20 @@ void ToolBarWindow::setupUI()
         adjustHeight();
     });
 
+    sliceButton = new QPushButton("✂", this);
+    sliceButton->setFixedSize(30, 30);
+    sliceButton->setStyleSheet(buttonStyle +
+                               "QPushButton { "
+                               "font-size: 18px; "
+                               "}");
+    sliceButton->setToolTip("添加导出切片");
+    connect(sliceButton, &QPushButton::clicked, [this]() {
+        setActiveButton(sliceButton);
+        emit modeChanged(7);
+        hide(); textSettings->hide(); mosaicSettings->hide(); shapeSettings->hide(); penSettings->hide(); show();
+        adjustHeight();
+    });
+
     dragButton = new QPushButton("✋", this);
     dragButton->setFixedSize(30, 30);
     dragButton->setStyleSheet(buttonStyle +
@@ -181,6 +196,15 @@ void ToolBarWindow::setupUI()
     undoButton->setToolTip("撤销上一步");
     connect(undoButton, &QPushButton::clicked, this, &ToolBarWindow::undoRequested);
 
+    saveButton = new QPushButton("💾", this);
+    saveButton->setFixedSize(50, 30);
+    saveButton->setStyleSheet(buttonStyle +
+                              "QPushButton { "
+                              "font-size: 18px; "
+                              "}");
+    saveButton->setToolTip("保存为文件");
+    connect(saveButton, &QPushButton::clicked, this, &ToolBarWindow::saveRequested);
+
     finishButton = new QPushButton("✅", this);
     finishButton->setFixedSize(50, 30);
     finishButton->setStyleSheet(buttonStyle +
@@ -206,10 +230,25 @@ void ToolBarWindow::setupUI()
     buttonLayout->addWidget(mosaicButton);
     buttonLayout->addWidget(numberNoteButton);
     buttonLayout->addWidget(arrowButton);
+    buttonLayout->addWidget(sliceButton);
     buttonLayout->addWidget(dragButton);
     buttonLayout->addWidget(undoButton);
+    buttonLayout->addWidget(saveButton);
     buttonLayout->addWidget(finishButton);
     buttonLayout->addWidget(cancelButton);
+
+    moreButton = new QPushButton("⋯", this);
+    moreButton->setFixedSize(30, 30);
+    moreButton->setStyleSheet(buttonStyle +
+                              "QPushButton { "
+                              "font-size: 18px; "
+                              "}");
+    moreButton->setToolTip("更多选项");
+    setupMoreMenu();
+    connect(moreButton, &QPushButton::clicked, [this]() {
+        moreMenu->popup(moreButton->mapToGlobal(QPoint(0, moreButton->height())));
+    });
+    buttonLayout->addWidget(moreButton);
     buttonLayout->addStretch();
 
     textSettings = new QWidget(this);
@@ -313,6 +352,59 @@ void ToolBarWindow::setupUI()
     setLayout(mainLayout);
 }
 
+void ToolBarWindow::setupMoreMenu()
+{
+    // 不常用的导出选项放在菜单里，避免工具栏过长
+    moreMenu = new QMenu(this);
+
+    QMenu *sizeMenu = moreMenu->addMenu("导出尺寸");
+    QActionGroup *sizeGroup = new QActionGroup(this);
+    struct SizeOption { const char *text; int maxWidth; qreal scale; };
+    const SizeOption sizeOptions[] = {
+        {"原始尺寸", 0, 1.0},
+        {"最大宽度 1280", 1280, 1.0},
+        {"最大宽度 800", 800, 1.0},
+        {"放大 2×（高分屏文档）", 0, 2.0},
+    };
+    for (const SizeOption &option : sizeOptions) {
+        QAction *action = sizeMenu->addAction(option.text);
+        action->setCheckable(true);
+        action->setChecked(option.maxWidth == 0 && option.scale == 1.0);
+        sizeGroup->addAction(action);
+        int maxWidth = option.maxWidth;
+        qreal scale = option.scale;
+        connect(action, &QAction::triggered, this, [this, maxWidth, scale]() {
+            emit exportSizeChanged(maxWidth, scale);
+        });
+    }
+
+    QMenu *filterMenu = moreMenu->addMenu("缩放算法");
+    QActionGroup *filterGroup = new QActionGroup(this);
+    const QStringList filterNames = {"区域平均（Box）", "Lanczos3"};
+    for (int filter = 0; filter < filterNames.size(); ++filter) {
+        QAction *action = filterMenu->addAction(filterNames[filter]);
+        action->setCheckable(true);
+        action->setChecked(filter == 1);
+        filterGroup->addAction(action);
+        connect(action, &QAction::triggered, this, [this, filter]() {
+            emit resampleFilterChanged(filter);
+        });
+    }
+
+    moreMenu->addSeparator();
+    connect(moreMenu->addAction("为每个序号笔记添加切片"), &QAction::triggered, this, &ToolBarWindow::slicesFromNotesRequested);
+    connect(moreMenu->addAction("清除全部切片"), &QAction::triggered, this, &ToolBarWindow::clearSlicesRequested);
+    connect(moreMenu->addAction("导出全图和全部切片…"), &QAction::triggered, this, &ToolBarWindow::exportSlicesRequested);
+    moreMenu->addSeparator();
+    connect(moreMenu->addAction("遮盖全部建议区域"), &QAction::triggered, this, &ToolBarWindow::maskSuggestionsRequested);
+    connect(moreMenu->addAction("隐藏打码建议"), &QAction::triggered, this, &ToolBarWindow::clearSuggestionsRequested);
+    connect(moreMenu->addAction("框选内容，遮盖所有相同之处"), &QAction::triggered, this, &ToolBarWindow::findSimilarRequested);
+    connect(moreMenu->addAction("与之前的截图比较…"), &QAction::triggered, this, &ToolBarWindow::compareRequested);
+    connect(moreMenu->addAction("保存为可编辑项目…"), &QAction::triggered, this, &ToolBarWindow::saveProjectRequested);
+    connect(moreMenu->addAction("滚动截图…"), &QAction::triggered, this, &ToolBarWindow::scrollCaptureRequested);
+    connect(moreMenu->addAction("录制动画…"), &QAction::triggered, this, &ToolBarWindow::recordRequested);
+}
+
 void ToolBarWindow::setActiveButton(QPushButton *button)
 {
     // 重置所有按钮的样式为默认状态
@@ -338,10 +430,13 @@ void ToolBarWindow::setActiveButton(QPushButton *button)
                                     "font-size: 16px; "
                                     "}");
     arrowButton->setStyleSheet(defaultStyle + "QPushButton { font-size: 18px; }");
+    sliceButton->setStyleSheet(defaultStyle + "QPushButton { font-size: 18px; }");
     dragButton->setStyleSheet(defaultStyle);
     undoButton->setStyleSheet(defaultStyle);
+    saveButton->setStyleSheet(defaultStyle);
     finishButton->setStyleSheet(defaultStyle);
     cancelButton->setStyleSheet(defaultStyle);
+    moreButton->setStyleSheet(defaultStyle);
 
     // 为选中的按钮应用高亮样式
     if (button) {
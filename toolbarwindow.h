@@ -6,6 +6,7 @@
 #include <QSlider>
 #include <QSpinBox>
 #include <QColorDialog>
+#include <QMenu>
 
 class EditWindow;
 
@@ -22,6 +23,7 @@ signals:
     void dragModeChanged(bool enabled);
     void undoRequested();
     void finishRequested();
+    void saveRequested();
     void cancelRequested();
     void textFontSizeChanged(int size);
     void textColorChanged(const QColor &color);
@@ -30,14 +32,27 @@ signals:
     void borderColorChanged(const QColor &color);
     void penWidthChanged(int width);
     void penColorChanged(const QColor &color);
+    void exportSizeChanged(int maxWidth, qreal scale); // maxWidth 为 0 表示不限宽
+    void resampleFilterChanged(int filter);            // ImageResampler::Filter
+    void slicesFromNotesRequested();
+    void clearSlicesRequested();
+    void exportSlicesRequested();
+    void saveProjectRequested();
+    void compareRequested();
+    void findSimilarRequested();
+    void maskSuggestionsRequested();
+    void clearSuggestionsRequested();
+    void scrollCaptureRequested();
+    void recordRequested();
 
 protected:
     void paintEvent(QPaintEvent *event) override;
 
 private:
     EditWindow *editWindow;
-    QPushButton *rectButton, *circleButton, *textButton, *penButton, *mosaicButton, *numberNoteButton, *dragButton, *arrowButton;
-    QPushButton *undoButton, *finishButton, *cancelButton;
+    QPushButton *rectButton, *circleButton, *textButton, *penButton, *mosaicButton, *numberNoteButton, *dragButton, *arrowButton, *sliceButton;
+    QPushButton *undoButton, *saveButton, *finishButton, *cancelButton, *moreButton;
+    QMenu *moreMenu;
     QWidget *textSettings, *mosaicSettings, *shapeSettings, *penSettings;
     QSlider *fontSizeSlider;
     QPushButton *colorBlock;
@@ -49,6 +64,7 @@ private:
     QColor textColor;
 
     void setupUI();
+    void setupMoreMenu();
     void showSettings(QWidget *settingsWidget, QPushButton *button);
     void adjustHeight();
 };
@@ -0,0 +1,372 @@
+#include "vectorexporter.h"
+#include "shaperenderer.h"
+#include "pngencoder.h"
+#include <QPdfWriter>
+#include <QPageSize>
+#include <QPageLayout>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QImageWriter>
+#include <QXmlStreamWriter>
+#include <QTextLayout>
+#include <QFontMetricsF>
+#include <QPolygon>
+#include <QFileInfo>
+#include <QDebug>
+
+static const int JpegQuality = 90;
+
+// 只包含遮罩的底图，遮罩之外的形状都以矢量形式输出。
+// 遮罩烧进底图只是为了不在文件中保留被遮住的像素，层叠顺序由 maskPatch 负责
+static QImage rasterBase(const ExportJob &job)
+{
+    QImage image = job.capture.copy(job.viewport);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-job.viewport.topLeft());
+    for (const Shape &shape : job.shapes) {
+        if (shape.type == Mask) {
+            ShapeRenderer::draw(painter, shape);
+        }
+    }
+    painter.end();
+    return image;
+}
+
+// 单个遮罩在透明背景上的栅格化结果，origin 为其在原始截图中的位置。
+// 按形状列表的顺序输出，盖住排在它前面的形状，排在后面的形状仍然画在它上面
+static QImage maskPatch(const Shape &shape, const QRect &viewport, QPoint &origin)
+{
+    QRect bounds = shape.rect;
+    if (!shape.points.isEmpty()) {
+        int margin = shape.width / 2 + 1;
+        bounds = QPolygon(shape.points).boundingRect().adjusted(-margin, -margin, margin, margin);
+    }
+    bounds &= viewport;
+    if (bounds.isEmpty()) {
+        return QImage();
+    }
+    QImage patch(bounds.size(), QImage::Format_ARGB32_Premultiplied);
+    patch.fill(Qt::transparent);
+    QPainter painter(&patch);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-bounds.topLeft());
+    ShapeRenderer::draw(painter, shape);
+    painter.end();
+    origin = bounds.topLeft();
+    return patch;
+}
+
+// JPEG 明显更小（照片、渐变）时用 JPEG，否则用无损的 PNG，文字边缘不会出现压缩噪点
+static bool preferJpeg(const QImage &base, QByteArray &png, QByteArray &jpeg)
+{
+    png = PngEncoder(PngEncoder::Fastest).encode(base);
+    if (base.hasAlphaChannel()) {
+        return false;
+    }
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpeg");
+    writer.setQuality(JpegQuality);
+    writer.write(base);
+    return !jpeg.isEmpty() && jpeg.size() * 3 < png.size();
+}
+
+static QSize outputSize(const ExportJob &job)
+{
+    return job.outputSize.isValid() && !job.outputSize.isEmpty() ? job.outputSize : job.viewport.size();
+}
+
+bool VectorExporter::write(const ExportJob &job)
+{
+    return job.format == ExportJob::Pdf ? writePdf(job) : writeSvg(job);
+}
+
+bool VectorExporter::writePdf(const ExportJob &job)
+{
+    QImage base = rasterBase(job);
+    QByteArray png, jpeg;
+    bool jpegBase = preferJpeg(base, png, jpeg);
+
+    // 96 DPI 下 1 个设备单位等于 1 个截图像素，字号与屏幕上绘制时一致
+    QSize size = outputSize(job);
+    QPdfWriter writer(job.filePath);
+    writer.setResolution(96);
+    writer.setPageSize(QPageSize(QSizeF(size) * 72.0 / 96.0, QPageSize::Point));
+    writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+    writer.setCreator("ScreenshotTool");
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        return false;
+    }
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::LosslessImageRendering, !jpegBase);
+    painter.scale(double(size.width()) / job.viewport.width(), double(size.height()) / job.viewport.height());
+    painter.drawImage(0, 0, base);
+    painter.translate(-job.viewport.topLeft());
+    for (const Shape &shape : job.shapes) {
+        if (shape.type != Mask) {
+            ShapeRenderer::draw(painter, shape);
+            continue;
+        }
+        QPoint origin;
+        QImage patch = maskPatch(shape, job.viewport, origin);
+        if (!patch.isNull()) {
+            painter.save();
+            painter.setRenderHint(QPainter::LosslessImageRendering);
+            painter.drawImage(origin, patch);
+            painter.restore();
+        }
+    }
+    bool ok = painter.end();
+    qDebug() << "VectorExporter: PDF" << job.filePath << ", base:" << (jpegBase ? "jpeg" : "png")
+             << ", bytes:" << QFileInfo(job.filePath).size();
+    return ok;
+}
+
+// ---- SVG ----
+
+struct TextLine {
+    QString text;
+    qreal width;
+    qreal top; // 行顶相对于文本块顶部
+    qreal ascent;
+};
+
+// 按 drawText 的 Qt::TextWordWrap 规则折行，SVG 1.1 没有自动换行
+static QList<TextLine> layoutText(const QString &text, const QFont &font, qreal width, qreal &totalHeight)
+{
+    static const QImage reference(1, 1, QImage::Format_ARGB32_Premultiplied); // 与导出位图相同的 96 DPI
+    QList<TextLine> lines;
+    qreal y = 0;
+    const QStringList paragraphs = text.split('\n');
+    for (const QString &paragraph : paragraphs) {
+        QTextLayout layout(paragraph, font, const_cast<QImage *>(&reference));
+        QTextOption option;
+        option.setWrapMode(QTextOption::WordWrap);
+        layout.setTextOption(option);
+        layout.beginLayout();
+        for (QTextLine line = layout.createLine(); line.isValid(); line = layout.createLine()) {
+            line.setLineWidth(width);
+            lines.append({paragraph.mid(line.textStart(), line.textLength()).trimmed(), line.naturalTextWidth(), y, line.ascent()});
+            y += line.height();
+        }
+        layout.endLayout();
+    }
+    totalHeight = y;
+    return lines;
+}
+
+static QString number(qreal value)
+{
+    return QString::number(value, 'g', 6);
+}
+
+static void writePaint(QXmlStreamWriter &xml, const QString &attribute, const QColor &color)
+{
+    if (!color.isValid() || color.alpha() == 0) {
+        xml.writeAttribute(attribute, "none");
+        return;
+    }
+    xml.writeAttribute(attribute, color.name());
+    if (color.alpha() != 255) {
+        xml.writeAttribute(attribute + "-opacity", number(color.alphaF()));
+    }
+}
+
+static void writeStroke(QXmlStreamWriter &xml, const Shape &shape, bool round)
+{
+    xml.writeAttribute("fill", "none");
+    writePaint(xml, "stroke", shape.color);
+    xml.writeAttribute("stroke-width", QString::number(shape.width));
+    if (round) {
+        xml.writeAttribute("stroke-linecap", "round");
+        xml.writeAttribute("stroke-linejoin", "round");
+    }
+}
+
+static void writeLine(QXmlStreamWriter &xml, const QPointF &from, const QPointF &to)
+{
+    xml.writeStartElement("line");
+    xml.writeAttribute("x1", number(from.x()));
+    xml.writeAttribute("y1", number(from.y()));
+    xml.writeAttribute("x2", number(to.x()));
+    xml.writeAttribute("y2", number(to.y()));
+    xml.writeEndElement();
+}
+
+// 在 rect 中排版文本；centered 对应 Qt::AlignCenter，否则为 Qt::AlignLeft 顶部对齐
+static void writeText(QXmlStreamWriter &xml, const QString &text, const QFont &font, const QColor &color,
+                      const QRectF &rect, bool centered)
+{
+    qreal totalHeight = 0;
+    const QList<TextLine> lines = layoutText(text, font, rect.width(), totalHeight);
+    qreal top = centered ? rect.top() + (rect.height() - totalHeight) / 2 : rect.top();
+
+    xml.writeStartElement("text");
+    xml.writeAttribute("font-family", font.family());
+    xml.writeAttribute("font-size", number(font.pointSizeF() * 96.0 / 72.0));
+    writePaint(xml, "fill", color);
+    xml.writeAttribute("xml:space", "preserve");
+    if (centered) {
+        xml.writeAttribute("text-anchor", "middle");
+    }
+    for (const TextLine &line : lines) {
+        xml.writeStartElement("tspan");
+        xml.writeAttribute("x", number(centered ? rect.center().x() : rect.left()));
+        xml.writeAttribute("y", number(top + line.top + line.ascent));
+        xml.writeCharacters(line.text);
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+}
+
+static void writeShape(QXmlStreamWriter &xml, const Shape &shape, const QRect &viewport)
+{
+    switch (shape.type) {
+    case Rectangle:
+        xml.writeStartElement("rect");
+        xml.writeAttribute("x", QString::number(shape.rect.x()));
+        xml.writeAttribute("y", QString::number(shape.rect.y()));
+        xml.writeAttribute("width", QString::number(shape.rect.width()));
+        xml.writeAttribute("height", QString::number(shape.rect.height()));
+        writeStroke(xml, shape, false);
+        xml.writeEndElement();
+        break;
+    case Ellipse:
+        xml.writeStartElement("ellipse");
+        xml.writeAttribute("cx", number(shape.rect.x() + shape.rect.width() / 2.0));
+        xml.writeAttribute("cy", number(shape.rect.y() + shape.rect.height() / 2.0));
+        xml.writeAttribute("rx", number(shape.rect.width() / 2.0));
+        xml.writeAttribute("ry", number(shape.rect.height() / 2.0));
+        writeStroke(xml, shape, false);
+        xml.writeEndElement();
+        break;
+    case Pen: {
+        QStringList points;
+        for (const QPoint &point : shape.points) {
+            points.append(QString("%1,%2").arg(point.x()).arg(point.y()));
+        }
+        xml.writeStartElement("polyline");
+        xml.writeAttribute("points", points.join(' '));
+        writeStroke(xml, shape, true);
+        xml.writeEndElement();
+        break;
+    }
+    case Arrow:
+        if (shape.points.size() == 2) {
+            QPointF wing1, wing2;
+            ShapeRenderer::arrowHead(shape, wing1, wing2);
+            xml.writeStartElement("g");
+            writeStroke(xml, shape, true);
+            writeLine(xml, shape.points[0], shape.points[1]);
+            writeLine(xml, shape.points[1], wing1);
+            writeLine(xml, shape.points[1], wing2);
+            xml.writeEndElement();
+        }
+        break;
+    case Text:
+        writeText(xml, shape.text, QFont("Arial", shape.width), shape.color, shape.rect, false);
+        break;
+    case NumberedNote: {
+        // 与 ShapeRenderer 的布局一致：32px 红色圆形序号，右侧气泡框
+        const int boxSize = 32;
+        QFont numberFont("Arial", 16);
+        QPointF center = QPointF(shape.rect.topLeft()) + QPointF(boxSize / 2.0, boxSize / 2.0);
+        xml.writeStartElement("circle");
+        xml.writeAttribute("cx", number(center.x()));
+        xml.writeAttribute("cy", number(center.y()));
+        xml.writeAttribute("r", number(boxSize / 2.0));
+        xml.writeAttribute("fill", "#ff0000");
+        xml.writeEndElement();
+
+        xml.writeStartElement("text");
+        xml.writeAttribute("font-family", numberFont.family());
+        xml.writeAttribute("font-size", number(numberFont.pointSizeF() * 96.0 / 72.0));
+        xml.writeAttribute("fill", "#ffffff");
+        xml.writeAttribute("text-anchor", "middle");
+        xml.writeAttribute("x", number(center.x()));
+        xml.writeAttribute("y", number(center.y() + QFontMetricsF(numberFont).height() / 4));
+        xml.writeCharacters(QString::number(shape.number));
+        xml.writeEndElement();
+
+        if (!shape.bubbleRect.isNull()) {
+            xml.writeStartElement("rect");
+            xml.writeAttribute("x", QString::number(shape.bubbleRect.x()));
+            xml.writeAttribute("y", QString::number(shape.bubbleRect.y()));
+            xml.writeAttribute("width", QString::number(shape.bubbleRect.width()));
+            xml.writeAttribute("height", QString::number(shape.bubbleRect.height()));
+            xml.writeAttribute("rx", "5");
+            writePaint(xml, "fill", shape.bubbleColor);
+            writePaint(xml, "stroke", shape.bubbleBorderColor);
+            xml.writeAttribute("stroke-width", "1");
+            xml.writeEndElement();
+
+            QString contentText = shape.text.mid(shape.text.indexOf(". ") + 2);
+            writeText(xml, contentText, QFont("Arial", shape.width), shape.color, shape.bubbleRect, true);
+        }
+        break;
+    }
+    case Mask: {
+        QPoint origin;
+        QImage patch = maskPatch(shape, viewport, origin);
+        if (!patch.isNull()) {
+            xml.writeStartElement("image");
+            xml.writeAttribute("x", QString::number(origin.x()));
+            xml.writeAttribute("y", QString::number(origin.y()));
+            xml.writeAttribute("width", QString::number(patch.width()));
+            xml.writeAttribute("height", QString::number(patch.height()));
+            xml.writeAttribute("http://www.w3.org/1999/xlink", "href",
+                               "data:image/png;base64," + QString::fromLatin1(PngEncoder(PngEncoder::Fastest).encode(patch).toBase64()));
+            xml.writeEndElement();
+        }
+        break;
+    }
+    }
+}
+
+bool VectorExporter::writeSvg(const ExportJob &job)
+{
+    QImage base = rasterBase(job);
+    QByteArray png, jpeg;
+    bool jpegBase = preferJpeg(base, png, jpeg);
+    QByteArray dataUri = (jpegBase ? "data:image/jpeg;base64," + jpeg.toBase64() : "data:image/png;base64," + png.toBase64());
+
+    QSaveFile file(job.filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    // viewBox 使用截图像素坐标，导出尺寸只影响 width/height，矢量部分按目标尺寸清晰渲染
+    QSize size = outputSize(job);
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("svg");
+    xml.writeDefaultNamespace("http://www.w3.org/2000/svg");
+    xml.writeNamespace("http://www.w3.org/1999/xlink", "xlink");
+    xml.writeAttribute("version", "1.1");
+    xml.writeAttribute("width", QString::number(size.width()));
+    xml.writeAttribute("height", QString::number(size.height()));
+    xml.writeAttribute("viewBox", QString("0 0 %1 %2").arg(job.viewport.width()).arg(job.viewport.height()));
+
+    xml.writeStartElement("image");
+    xml.writeAttribute("width", QString::number(base.width()));
+    xml.writeAttribute("height", QString::number(base.height()));
+    xml.writeAttribute("http://www.w3.org/1999/xlink", "href", QString::fromLatin1(dataUri));
+    xml.writeEndElement();
+
+    xml.writeStartElement("g");
+    xml.writeAttribute("transform", QString("translate(%1 %2)").arg(-job.viewport.x()).arg(-job.viewport.y()));
+    for (const Shape &shape : job.shapes) {
+        writeShape(xml, shape, job.viewport);
+    }
+    xml.writeEndElement();
+
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    bool ok = !xml.hasError() && file.commit();
+    qDebug() << "VectorExporter: SVG" << job.filePath << ", base:" << (jpegBase ? "jpeg" : "png")
+             << ", shapes:" << job.shapes.size() << ", ok:" << ok;
+    return ok;
+}
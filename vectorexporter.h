@@ -0,0 +1,16 @@
+#ifndef VECTOREXPORTER_H
+#define VECTOREXPORTER_H
+
+#include "exportpipeline.h"
+
+// 矢量导出：底图只嵌入一次（照片类内容用 JPEG，界面截图用 PNG），
+// 形状写成 PDF/SVG 的原生矢量图元和文字，放大后依然清晰。
+// 遮罩会直接烧进底图，导出文件中不会保留被遮住的像素；同时按形状顺序输出遮罩的栅格小图，保持层叠顺序。
+class VectorExporter {
+public:
+    static bool write(const ExportJob &job); // 按 job.format 写 PDF 或 SVG
+    static bool writePdf(const ExportJob &job);
+    static bool writeSvg(const ExportJob &job);
+};
+
+#endif // VECTOREXPORTER_H
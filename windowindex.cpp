@@ -0,0 +1,141 @@
+#include "windowindex.h"
+#include <QElapsedTimer>
+#include <QDebug>
+
+#ifdef HAVE_X11
+// Xlib 的头文件定义了 None、Bool 等宏，只在这里、放在 Qt 头文件之后包含
+#include <X11/Xlib.h>
+#endif
+
+static const int MinWindowSize = 8;  // 太小的窗口（隐藏的输入窗口等）不参与选择
+static const int MaxTreeDepth = 4;   // 顶层窗口以下最多再查询的层数
+
+void WindowIndex::addWindow(const QRect &rect, int topLevel)
+{
+    windows.append({rect, topLevel});
+}
+
+#ifdef HAVE_X11
+
+// 遍历期间窗口随时可能被销毁，之后的查询会得到 BadWindow。Xlib 默认的错误处理会直接退出进程，
+// 遍历时临时换成只计数的处理函数，出错的查询返回失败，对应的窗口被跳过
+static int xErrors = 0;
+
+static int countXError(Display *, XErrorEvent *)
+{
+    ++xErrors;
+    return 0;
+}
+
+// 深度优先、先父后子、兄弟从下到上，得到的顺序就是绘制顺序。rect 和 clip 都是根窗口的设备像素坐标
+static void collect(Display *display, Window window, const QPoint &origin, const QRect &clip, int depth,
+                    int topLevel, QList<QPair<QRect, int>> &out)
+{
+    Window root = 0;
+    Window parent = 0;
+    Window *children = nullptr;
+    unsigned int count = 0;
+    if (!XQueryTree(display, window, &root, &parent, &children, &count)) {
+        return;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+        XWindowAttributes attributes{};
+        if (!XGetWindowAttributes(display, children[i], &attributes) || attributes.map_state != IsViewable
+            || attributes.c_class == InputOnly) {
+            continue;
+        }
+        QRect rect = QRect(origin.x() + attributes.x, origin.y() + attributes.y, attributes.width, attributes.height) & clip;
+        if (rect.width() < MinWindowSize || rect.height() < MinWindowSize) {
+            continue;
+        }
+        int index = int(out.size());
+        out.append({rect, topLevel < 0 ? index : topLevel});
+        if (depth < MaxTreeDepth) {
+            // 子窗口坐标相对于父窗口的内容区，要加上边框宽度
+            QPoint childOrigin(origin.x() + attributes.x + attributes.border_width, origin.y() + attributes.y + attributes.border_width);
+            collect(display, children[i], childOrigin, rect, depth + 1, topLevel < 0 ? index : topLevel, out);
+        }
+    }
+    if (children) {
+        XFree(children);
+    }
+}
+
+#endif
+
+void WindowIndex::build(const QRect &screenGeometry, qreal devicePixelRatio)
+{
+    windows.clear();
+    bounds = QRect(QPoint(0, 0), screenGeometry.size());
+#ifdef HAVE_X11
+    QElapsedTimer timer;
+    timer.start();
+    Display *display = XOpenDisplay(nullptr);
+    if (!display) {
+        qDebug() << "WindowIndex: Cannot open X display";
+        return;
+    }
+    QList<QPair<QRect, int>> found;
+    xErrors = 0;
+    XErrorHandler previousHandler = XSetErrorHandler(countXError);
+    Window root = DefaultRootWindow(display);
+    XWindowAttributes rootAttributes{};
+    if (XGetWindowAttributes(display, root, &rootAttributes)) {
+        collect(display, root, QPoint(0, 0), QRect(0, 0, rootAttributes.width, rootAttributes.height), 0, -1, found);
+    }
+    // 处理完所有还没返回的错误再恢复原来的处理函数
+    XSync(display, False);
+    XSetErrorHandler(previousHandler);
+    XCloseDisplay(display);
+    if (xErrors > 0) {
+        qDebug() << "WindowIndex: Skipped windows that disappeared during the walk, X errors:" << xErrors;
+    }
+
+    // 设备像素转换成相对于遮罩的逻辑坐标
+    for (const auto &window : std::as_const(found)) {
+        const QRect &r = window.first;
+        QRect rect(qRound(r.x() / devicePixelRatio), qRound(r.y() / devicePixelRatio),
+                   qRound(r.width() / devicePixelRatio), qRound(r.height() / devicePixelRatio));
+        addWindow(rect.translated(-screenGeometry.topLeft()), window.second);
+    }
+    buildGrid();
+    qDebug() << "WindowIndex: Indexed" << windows.size() << "windows in" << timer.elapsed() << "ms";
+#else
+    Q_UNUSED(devicePixelRatio);
+#endif
+}
+
+void WindowIndex::buildGrid()
+{
+    columns = (bounds.width() + CellSize - 1) / CellSize;
+    int rows = (bounds.height() + CellSize - 1) / CellSize;
+    cells = QVector<QVector<int>>(columns * rows);
+    for (int i = 0; i < windows.size(); ++i) {
+        QRect rect = windows[i].rect & bounds;
+        if (rect.isEmpty()) {
+            continue;
+        }
+        for (int y = rect.top() / CellSize; y <= rect.bottom() / CellSize; ++y) {
+            for (int x = rect.left() / CellSize; x <= rect.right() / CellSize; ++x) {
+                cells[y * columns + x].append(i);
+            }
+        }
+    }
+}
+
+QRect WindowIndex::windowAt(const QPoint &pos, bool topLevelOnly) const
+{
+    if (!bounds.contains(pos) || cells.isEmpty()) {
+        return QRect();
+    }
+    // 格子里的序号按绘制顺序递增，从后往前第一个包含该点的就是最上层的窗口
+    const QVector<int> &cell = cells[(pos.y() / CellSize) * columns + pos.x() / CellSize];
+    for (int i = cell.size() - 1; i >= 0; --i) {
+        const Entry &entry = windows[cell[i]];
+        if (entry.rect.contains(pos)) {
+            // 窗口可能伸出屏幕，返回的范围裁剪到遮罩内
+            return (topLevelOnly ? windows[entry.topLevel].rect : entry.rect) & bounds;
+        }
+    }
+    return QRect();
+}
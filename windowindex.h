@@ -0,0 +1,37 @@
+#ifndef WINDOWINDEX_H
+#define WINDOWINDEX_H
+
+#include <QRect>
+#include <QList>
+#include <QVector>
+
+// 截图时一次性查询的窗口几何树，用于悬停高亮和单击选中窗口。
+// 窗口按绘制顺序（从下到上，父窗口在子窗口之前）展平成列表，子窗口裁剪到父窗口内；
+// 再按固定大小的格子建立空间索引，每个格子记录与之相交的窗口序号。
+// 查询时只检查鼠标所在格子中的窗口，序号最大的就是最上层的，不需要再访问窗口系统。
+// 目前只在 X11（定义 HAVE_X11）上查询窗口树，其它平台上索引为空。
+class WindowIndex {
+public:
+    // screenGeometry 为遮罩所在屏幕的逻辑坐标，返回的矩形都相对于它的左上角
+    void build(const QRect &screenGeometry, qreal devicePixelRatio);
+    QRect windowAt(const QPoint &pos, bool topLevelOnly = false) const;
+    bool isEmpty() const { return windows.isEmpty(); }
+
+private:
+    struct Entry {
+        QRect rect;
+        int topLevel; // 所属顶层窗口在列表中的序号
+    };
+
+    static const int CellSize = 64;
+
+    QList<Entry> windows;
+    QRect bounds;
+    int columns = 0;
+    QVector<QVector<int>> cells;
+
+    void addWindow(const QRect &rect, int topLevel);
+    void buildGrid();
+};
+
+#endif // WINDOWINDEX_H